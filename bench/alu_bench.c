@@ -0,0 +1,112 @@
+/* alu_bench.c
+ * Thomas J. Armytage 2025 ( https://github.com/tommojphillips/ )
+ * Intel 8086 ALU Opcode Benchmark
+ */
+
+/* Time per instruction of each arithmetic opcode in the 00-3F block (ADD, OR,
+   ADC, SBB, AND, SUB, XOR, CMP). The r/m,reg forms (x0-x3) run once with a
+   register operand (mod 11) and once with a memory operand ([si]); the
+   AL/AX,imm forms (x4-x5) run once. Each program is the instruction repeated
+   64 times and a jmp back, run with i8086_execute().
+
+   To see the gain of the specialised handlers, build this file against the
+   tree before and after them, and compare the two tables. Use git worktree
+   for the older tree, and add whichever core .c files that tree has.
+
+   Build from the repository root:
+	gcc -O2 -Isrc bench/alu_bench.c src/i8086.c src/i8086_alu.c src/i8086_modrm.c
+		src/i8086_muldiv.c src/sign_extend.c -o alu_bench
+	./alu_bench [instructions per form] */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "i8086.h"
+#include "bench.h"
+
+#define REPEAT 64 // copies of the instruction in the program
+
+static const char* const op_names[8] = { "add", "or", "adc", "sbb", "and", "sub", "xor", "cmp" };
+static const char* const form_names[6] = { "rm8,r8", "rm16,r16", "r8,rm8", "r16,rm16", "al,imm8", "ax,imm16" };
+
+static I8086 cpu;
+static uint8_t program[REPEAT * 4 + 2];
+
+/* Build the program for an opcode; modrm is ignored by the accumulator forms. Returns 0 if unused */
+static uint32_t build(uint8_t opcode, uint8_t modrm) {
+	uint32_t n = 0;
+	uint8_t form = opcode & 0x7;
+	for (int i = 0; i < REPEAT; ++i) {
+		program[n++] = opcode;
+		if (form < 4) {
+			program[n++] = modrm;
+		}
+		else if (form == 4) {
+			program[n++] = 0x35;
+		}
+		else {
+			program[n++] = 0x35;
+			program[n++] = 0x12;
+		}
+	}
+	program[n++] = 0xE9; // jmp near 0
+	uint16_t disp = (uint16_t)(0 - (n + 2));
+	program[n++] = disp & 0xFF;
+	program[n++] = disp >> 8;
+	return n;
+}
+
+/* ns per instruction of the built program */
+static double run(uint32_t size, uint64_t instructions) {
+	double best = 1e9;
+	bench_load(program, size);
+	for (int r = 0; r < 3; ++r) {
+		bench_setup(&cpu);
+		cpu.registers[0].r16 = 0x1234; // AX
+		cpu.registers[3].r16 = 0x5678; // BX
+		cpu.registers[6].r16 = 0x0100; // SI
+		double t = bench_time();
+		for (uint64_t i = 0; i < instructions; ++i) {
+			i8086_execute(&cpu);
+		}
+		t = (bench_time() - t) / instructions * 1e9;
+		if (t < best) {
+			best = t;
+		}
+	}
+	return best;
+}
+
+int main(int argc, char** argv) {
+	uint64_t instructions = argc > 1 ? strtoull(argv[1], NULL, 10) : 5000000;
+	double total_reg = 0;
+	double total_mem = 0;
+	int count_reg = 0;
+	int count_mem = 0;
+
+	printf("opcode  instruction       reg ns   mem ns\n");
+	for (uint8_t op = 0; op < 8; ++op) {
+		for (uint8_t form = 0; form < 6; ++form) {
+			uint8_t opcode = (op << 3) | form;
+			if (form < 4) {
+				/* mod 11: al/ax, bl/bx. mod 00: [si] */
+				double reg = run(build(opcode, 0xC3), instructions);
+				double mem = run(build(opcode, 0x04), instructions);
+				printf("%02X      %-4s %-12s %6.2f   %6.2f\n", opcode, op_names[op], form_names[form], reg, mem);
+				total_reg += reg;
+				total_mem += mem;
+				count_reg++;
+				count_mem++;
+			}
+			else {
+				double reg = run(build(opcode, 0), instructions);
+				printf("%02X      %-4s %-12s %6.2f        -\n", opcode, op_names[op], form_names[form], reg);
+				total_reg += reg;
+				count_reg++;
+			}
+		}
+	}
+	printf("mean                      %6.2f   %6.2f\n", total_reg / count_reg, total_mem / count_mem);
+	return 0;
+}
@@ -0,0 +1,92 @@
+/* bench.h
+ * Thomas J. Armytage 2025 ( https://github.com/tommojphillips/ )
+ * Intel 8086 Benchmark Helpers
+ */
+
+/* Flat 1MB memory bus, a monotonic timer and cpu setup shared by the
+   benchmarks in this directory. Each benchmark is a single translation unit
+   built together with the core sources; see the header of each file. */
+
+#ifndef I8086_BENCH_H
+#define I8086_BENCH_H
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+#include "i8086.h"
+
+static uint8_t bench_mem[0x100000];
+
+static uint8_t bench_read_mem_byte(I8086* cpu, void* user, uint20_t address) {
+	(void)cpu;
+	(void)user;
+	return bench_mem[address & 0xFFFFF];
+}
+static void bench_write_mem_byte(I8086* cpu, void* user, uint20_t address, uint8_t value) {
+	(void)cpu;
+	(void)user;
+	bench_mem[address & 0xFFFFF] = value;
+}
+static uint8_t bench_read_io_byte(I8086* cpu, void* user, uint16_t port) {
+	(void)cpu;
+	(void)user;
+	return (uint8_t)port;
+}
+static void bench_write_io_byte(I8086* cpu, void* user, uint16_t port, uint8_t value) {
+	(void)cpu;
+	(void)user;
+	(void)port;
+	(void)value;
+}
+
+/* Seconds from an arbitrary start */
+static double bench_time(void) {
+#ifdef _WIN32
+	LARGE_INTEGER f, t;
+	QueryPerformanceFrequency(&f);
+	QueryPerformanceCounter(&t);
+	return (double)t.QuadPart / (double)f.QuadPart;
+#else
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+#endif
+}
+
+/* Set a segment register; i8086_set_segment() when the core caches segment bases */
+static void bench_set_segment(I8086* cpu, uint8_t segment, uint16_t value) {
+#ifdef I8086_SEGMENT_BASE
+	i8086_set_segment(cpu, segment, value);
+#else
+	cpu->segments[segment] = value;
+#endif
+}
+
+/* Init and reset a cpu on the flat bus; code at 1000:0000, data at 2000:0000, stack at 3000:FFF0 */
+static void bench_setup(I8086* cpu) {
+	i8086_init(cpu);
+	cpu->funcs.read_mem_byte = bench_read_mem_byte;
+	cpu->funcs.write_mem_byte = bench_write_mem_byte;
+	cpu->funcs.read_io_byte = bench_read_io_byte;
+	cpu->funcs.write_io_byte = bench_write_io_byte;
+	i8086_reset(cpu);
+	bench_set_segment(cpu, SEG_CS, 0x1000);
+	bench_set_segment(cpu, SEG_DS, 0x2000);
+	bench_set_segment(cpu, SEG_ES, 0x2000);
+	bench_set_segment(cpu, SEG_SS, 0x3000);
+	cpu->ip = 0;
+	cpu->registers[4].r16 = 0xFFF0; // SP
+}
+
+/* Copy a program to 1000:0000 */
+static void bench_load(const uint8_t* code, uint32_t size) {
+	memcpy(bench_mem + 0x10000, code, size);
+}
+
+#endif
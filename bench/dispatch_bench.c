@@ -0,0 +1,91 @@
+/* dispatch_bench.c
+ * Thomas J. Armytage 2025 ( https://github.com/tommojphillips/ )
+ * Intel 8086 Opcode Dispatch Benchmark
+ */
+
+/* Interpreter throughput of the opcode dispatch variants. The program is an
+   ALU/mov/push/pop/loop mix on the flat memory bus. MIPS is measured with
+   i8086_execute(), Mcycles/s with i8086_run(). Build once per variant and
+   compare the switch build with the other two.
+
+   Build from the repository root:
+	gcc -O2 -Isrc bench/dispatch_bench.c src/i8086.c src/i8086_alu.c src/i8086_modrm.c
+		src/i8086_muldiv.c src/sign_extend.c -o dispatch_table
+	... -DI8086_DISPATCH_SWITCH ... -o dispatch_switch
+	... -DI8086_DISPATCH_THREADED ... -o dispatch_threaded
+	./dispatch_switch [instructions] */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "i8086.h"
+#include "bench.h"
+
+#if defined(I8086_DISPATCH_SWITCH)
+#define DISPATCH_NAME "switch"
+#elif defined(I8086_DISPATCH_THREADED)
+#define DISPATCH_NAME "threaded"
+#else
+#define DISPATCH_NAME "table"
+#endif
+
+static const uint8_t program[] = {
+	0xB9, 0x00, 0x10,       // mov cx, 1000h
+	0xBE, 0x00, 0x20,       // mov si, 2000h
+	/* l: */
+	0x01, 0xD8,             // add ax, bx
+	0x89, 0x04,             // mov [si], ax
+	0x46,                   // inc si
+	0x33, 0x51, 0x04,       // xor dx, [bx+di+4]
+	0x3C, 0x12,             // cmp al, 12h
+	0x75, 0x00,             // jnz $+2
+	0x8B, 0xC3,             // mov ax, bx
+	0x81, 0xC3, 0x34, 0x12, // add bx, 1234h
+	0x26, 0x8A, 0x07,       // mov al, es:[bx]
+	0xD1, 0xE0,             // shl ax, 1
+	0x50,                   // push ax
+	0x5A,                   // pop dx
+	0xE2, 0xE5,             // loop l
+	0xEB, 0xDD,             // jmp 0
+};
+
+static I8086 cpu;
+
+int main(int argc, char** argv) {
+	uint64_t instructions = argc > 1 ? strtoull(argv[1], NULL, 10) : 50000000;
+	int runs = 5;
+	double best_mips = 0;
+	double best_mcycles = 0;
+
+	bench_load(program, sizeof(program));
+
+	for (int r = 0; r < runs; ++r) {
+		/* i8086_execute(); one instruction per call */
+		bench_setup(&cpu);
+		double t = bench_time();
+		for (uint64_t i = 0; i < instructions; ++i) {
+			i8086_execute(&cpu);
+		}
+		t = bench_time() - t;
+		if (instructions / t / 1e6 > best_mips) {
+			best_mips = instructions / t / 1e6;
+		}
+
+		/* i8086_run(); the same number of cycles in 1M cycle slices */
+		uint64_t cycles = cpu.cycles;
+		bench_setup(&cpu);
+		t = bench_time();
+		while (cpu.cycles < cycles) {
+			i8086_run(&cpu, 1000000);
+		}
+		t = bench_time() - t;
+		if (cpu.cycles / t / 1e6 > best_mcycles) {
+			best_mcycles = cpu.cycles / t / 1e6;
+		}
+	}
+
+	printf("%-8s  %6.1f MIPS (i8086_execute)  %7.1f Mcycles/s (i8086_run)  best of %d\n",
+		DISPATCH_NAME, best_mips, best_mcycles, runs);
+	return 0;
+}
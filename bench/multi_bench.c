@@ -0,0 +1,109 @@
+/* multi_bench.c
+ * Thomas J. Armytage 2025 ( https://github.com/tommojphillips/ )
+ * Intel 8086 Multi Instance Benchmark
+ */
+
+/* Throughput of many cpus run round robin in small i8086_run() slices, the way
+   a host with many emulated machines schedules them. Every cpu runs the same
+   ALU/mov/push/pop/loop mix with its own data, extra and stack segments. The
+   cpus live in one aligned heap array, so the cost of touching each state is
+   part of the measurement. Compare the same instance count and slice against
+   the tree before and after a change to the I8086 layout.
+
+   Build from the repository root:
+	gcc -O2 -Isrc bench/multi_bench.c src/i8086.c src/i8086_alu.c src/i8086_modrm.c
+		src/i8086_muldiv.c src/sign_extend.c -o multi_bench
+	./multi_bench [instances] [cycles per slice] [total Mcycles] */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "i8086.h"
+#include "bench.h"
+
+static const uint8_t program[] = {
+	0xB9, 0x00, 0x10,       // mov cx, 1000h
+	0xBE, 0x00, 0x20,       // mov si, 2000h
+	/* l: */
+	0x01, 0xD8,             // add ax, bx
+	0x89, 0x04,             // mov [si], ax
+	0x46,                   // inc si
+	0x33, 0x51, 0x04,       // xor dx, [bx+di+4]
+	0x3C, 0x12,             // cmp al, 12h
+	0x75, 0x00,             // jnz $+2
+	0x8B, 0xC3,             // mov ax, bx
+	0x81, 0xC3, 0x34, 0x12, // add bx, 1234h
+	0x26, 0x8A, 0x07,       // mov al, es:[bx]
+	0xD1, 0xE0,             // shl ax, 1
+	0x50,                   // push ax
+	0x5A,                   // pop dx
+	0xE2, 0xE5,             // loop l
+	0xEB, 0xDD,             // jmp 0
+};
+
+static I8086* alloc_cpus(int count) {
+	size_t size = sizeof(I8086) * count;
+#ifdef _WIN32
+	return (I8086*)_aligned_malloc(size, I8086_CACHE_LINE);
+#else
+	return (I8086*)aligned_alloc(I8086_CACHE_LINE, size);
+#endif
+}
+static void free_cpus(I8086* cpus) {
+#ifdef _WIN32
+	_aligned_free(cpus);
+#else
+	free(cpus);
+#endif
+}
+
+int main(int argc, char** argv) {
+	int count = argc > 1 ? atoi(argv[1]) : 64;
+	int slice = argc > 2 ? atoi(argv[2]) : 100;
+	uint64_t total = (argc > 3 ? strtoull(argv[3], NULL, 10) : 100) * 1000000;
+	int runs = 3;
+	double best = 0;
+
+	if (count < 1 || slice < 1) {
+		printf("usage: multi_bench [instances] [cycles per slice] [total Mcycles]\n");
+		return 1;
+	}
+
+	I8086* cpus = alloc_cpus(count);
+	if (cpus == NULL) {
+		printf("failed to allocate %d instances\n", count);
+		return 1;
+	}
+
+	bench_load(program, sizeof(program));
+
+	for (int r = 0; r < runs; ++r) {
+		/* code at 1000:0000 is shared; each cpu gets its own data, extra and stack segment */
+		for (int i = 0; i < count; ++i) {
+			I8086* cpu = &cpus[i];
+			bench_setup(cpu);
+			bench_set_segment(cpu, SEG_DS, (uint16_t)(0x2000 + i * 0x20));
+			bench_set_segment(cpu, SEG_ES, (uint16_t)(0x6000 + i * 0x20));
+			bench_set_segment(cpu, SEG_SS, (uint16_t)(0xA000 + i * 0x20));
+			cpu->registers[4].r16 = 0x0FF0; // SP
+		}
+
+		uint64_t cycles = 0;
+		double t = bench_time();
+		while (cycles < total) {
+			for (int i = 0; i < count; ++i) {
+				cycles += i8086_run(&cpus[i], slice).cycles;
+			}
+		}
+		t = bench_time() - t;
+		if (cycles / t / 1e6 > best) {
+			best = cycles / t / 1e6;
+		}
+	}
+
+	printf("%d instances of %u bytes, %d cycle slices: %.1f Mcycles/s  best of %d\n",
+		count, (unsigned)sizeof(I8086), slice, best, runs);
+	free_cpus(cpus);
+	return 0;
+}
@@ -0,0 +1,230 @@
+/* posted_io_bench.c
+ * Thomas J. Armytage 2025 ( https://github.com/tommojphillips/ )
+ * Intel 8086 Posted IO Benchmark
+ */
+
+/* Time per OUT with port 80h synchronous (write_io_byte() on the cpu thread) or
+   posted to a device thread (I8086_ENABLE_POSTED_IO). See Posted_IO.md.
+	- out:  an OUT every 13 instructions
+	- work: an OUT followed by K iterations of LOOP
+	- ping: OUT then IN from the same port; the round trip latency. The value read
+	  back and the order of the writes are checked
+
+   The device handler either busy waits or sleeps for the given time per write
+   (on Windows the sleep yields until the time is up). The cpu thread time is
+   measured up to the last OUT; the total includes draining the ring.
+
+   Build from the repository root:
+	gcc -O2 -Isrc -DI8086_ENABLE_POSTED_IO bench/posted_io_bench.c src/i8086.c src/i8086_io.c
+		src/i8086_alu.c src/i8086_modrm.c src/i8086_muldiv.c src/sign_extend.c -lpthread
+		-o posted_io_bench
+	./posted_io_bench <sync|posted> <out|work|ping> [handler ns] [busy|sleep] [outs] [K] */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "i8086.h"
+#include "i8086_io.h"
+#include "bench.h"
+
+#ifndef I8086_ENABLE_POSTED_IO
+#error "build with I8086_ENABLE_POSTED_IO"
+#endif
+
+#ifdef _WIN32
+typedef HANDLE THREAD;
+#define THREAD_FUNC DWORD WINAPI
+#define THREAD_RETURN 0
+#define LOAD(p) _InterlockedOr((volatile long*)(p), 0)
+#define STORE(p, v) _InterlockedExchange((volatile long*)(p), (long)(v))
+#define YIELD() SwitchToThread()
+#else
+#include <pthread.h>
+#include <sched.h>
+typedef pthread_t THREAD;
+#define THREAD_FUNC void*
+#define THREAD_RETURN NULL
+#define LOAD(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define STORE(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define YIELD() sched_yield()
+#endif
+
+#define PORT 0x80
+
+#define RUN_OUT  0
+#define RUN_WORK 1
+#define RUN_PING 2
+
+/* out: out dx,al in a loop with some alu work between */
+static const uint8_t program_out[] = {
+	0xBA, 0x80, 0x00,                               // mov dx, 80h
+	/* l: */
+	0xFE, 0xC0,                                     // inc al
+	0xEE,                                           // out dx, al
+	0x01, 0xD8, 0x01, 0xD8, 0x01, 0xD8, 0x01, 0xD8, // add ax, bx  x4
+	0x31, 0xC9, 0x31, 0xC9, 0x31, 0xC9, 0x31, 0xC9, // xor cx, cx  x4
+	0x50,                                           // push ax
+	0x5B,                                           // pop bx
+	0xEB, 0xE9,                                     // jmp l
+};
+/* work: out dx,al then K iterations of loop */
+static uint8_t program_work[] = {
+	0xBA, 0x80, 0x00,                               // mov dx, 80h
+	/* l: */
+	0xFE, 0xC0,                                     // inc al
+	0xEE,                                           // out dx, al
+	0xB9, 0x00, 0x00,                               // mov cx, K
+	/* l2: */
+	0xE2, 0xFE,                                     // loop l2
+	0xEB, 0xF6,                                     // jmp l
+};
+/* ping: out dx,al then in al,dx; the IN waits for the write to be handled */
+static const uint8_t program_ping[] = {
+	0xBA, 0x80, 0x00,                               // mov dx, 80h
+	/* l: */
+	0xFE, 0xC0,                                     // inc al
+	0xEE,                                           // out dx, al
+	0xEC,                                           // in al, dx
+	0xEB, 0xFA,                                     // jmp l
+};
+
+static I8086 cpu;
+static I8086_POSTED_IO io;
+
+static long handler_ns;   // time per write in the device handler
+static int handler_sleep; // 1: the handler sleeps (a disk or audio wait); 0: it busy waits
+static int check;         // check the value read back and the order of the writes
+static uint8_t last;      // last value written to the port
+static long stop;
+
+/* the device; handles one write to the port */
+static void device_write(uint8_t value) {
+	if (handler_ns != 0) {
+		double end = bench_time() + handler_ns * 1e-9;
+		if (handler_sleep) {
+#ifdef _WIN32
+			while (bench_time() < end) {
+				SwitchToThread();
+			}
+#else
+			struct timespec t = { 0, handler_ns };
+			nanosleep(&t, NULL);
+#endif
+		}
+		else {
+			while (bench_time() < end);
+		}
+	}
+	if (check && value != (uint8_t)(last + 1)) {
+		printf("write %02X out of order; expected %02X\n", value, (uint8_t)(last + 1));
+		exit(1);
+	}
+	last = value;
+}
+
+static uint8_t read_io_byte(I8086* c, void* user, uint16_t port) {
+	(void)user;
+	(void)port;
+	if (check && last != c->registers[REG_AX].l) {
+		printf("read %02X before the write of %02X was handled\n", last, c->registers[REG_AX].l);
+		exit(1);
+	}
+	return last;
+}
+static void write_io_byte(I8086* c, void* user, uint16_t port, uint8_t value) {
+	(void)c;
+	(void)user;
+	(void)port;
+	device_write(value);
+}
+
+static THREAD_FUNC device_main(void* arg) {
+	(void)arg;
+	while (!LOAD(&stop)) {
+		const I8086_IO_WRITE* w;
+		int n = 0;
+		while ((w = i8086_io_peek(&io)) != NULL) {
+			device_write((uint8_t)w->value);
+			i8086_io_pop(&io);
+			n++;
+		}
+		if (n == 0) {
+			YIELD();
+		}
+	}
+	return THREAD_RETURN;
+}
+
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		printf("usage: posted_io_bench <sync|posted> <out|work|ping> [handler ns] [busy|sleep] [outs] [K]\n");
+		return 1;
+	}
+	int posted = strcmp(argv[1], "posted") == 0;
+	int run = strcmp(argv[2], "ping") == 0 ? RUN_PING : strcmp(argv[2], "work") == 0 ? RUN_WORK : RUN_OUT;
+	handler_ns = argc > 3 ? atol(argv[3]) : 0;
+	handler_sleep = argc > 4 && strcmp(argv[4], "sleep") == 0;
+	uint64_t outs = argc > 5 ? strtoull(argv[5], NULL, 10) : 1000000;
+	int k = argc > 6 ? atoi(argv[6]) : 2000;
+	check = (run == RUN_PING);
+
+	switch (run) {
+		case RUN_OUT:
+			bench_load(program_out, sizeof(program_out));
+			break;
+		case RUN_WORK:
+			program_work[7] = k & 0xFF;
+			program_work[8] = (k >> 8) & 0xFF;
+			bench_load(program_work, sizeof(program_work));
+			break;
+		case RUN_PING:
+			bench_load(program_ping, sizeof(program_ping));
+			break;
+	}
+	bench_setup(&cpu);
+	cpu.funcs.read_io_byte = read_io_byte;
+	cpu.funcs.write_io_byte = write_io_byte;
+
+	THREAD thread;
+	if (posted) {
+		i8086_io_init(&io);
+		i8086_io_set_posted(&io, PORT, 1, 1);
+		i8086_set_posted_io(&cpu, &io);
+#ifdef _WIN32
+		thread = CreateThread(NULL, 0, device_main, NULL, 0, NULL);
+#else
+		pthread_create(&thread, NULL, device_main, NULL);
+#endif
+	}
+
+	double t0 = bench_time();
+	uint64_t n = 0;
+	while (n < outs) {
+		i8086_execute(&cpu);
+		if (cpu.opcode == 0xEE) {
+			n++;
+		}
+	}
+	double t1 = bench_time();
+	if (posted) {
+		i8086_set_posted_io(&cpu, NULL); // waits for the queued writes
+	}
+	double t2 = bench_time();
+
+	if (posted) {
+		STORE(&stop, 1);
+#ifdef _WIN32
+		WaitForSingleObject(thread, INFINITE);
+		CloseHandle(thread);
+#else
+		pthread_join(thread, NULL);
+#endif
+	}
+
+	printf("%-6s %-4s handler %ld ns (%s): cpu %.1f ns/out  total %.1f ns/out\n",
+		posted ? "posted" : "sync", argv[2], handler_ns, handler_sleep ? "sleep" : "busy",
+		(t1 - t0) / outs * 1e9, (t2 - t0) / outs * 1e9);
+	return 0;
+}
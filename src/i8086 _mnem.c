@@ -12,6 +12,7 @@
 
 #include "i8086.h"
 #include "i8086_mnem.h"
+#include "i8086_modrm.h"
 #include "sign_extend.h"
 
 #define CS mnem->segment // code segment register
@@ -197,7 +198,9 @@ static int jump_condition(I8086_MNEM* mnem) {
 }
 
 static uint8_t read_byte(I8086_MNEM* mnem, uint16_t segment, uint16_t offset) {
-	return mnem->state->funcs.read_mem_byte(i8086_get_physical_address(segment, offset));
+	/* the callbacks take a mutable cpu; the disassembler only reads memory through them */
+	I8086* cpu = (I8086*)mnem->state;
+	return cpu->funcs.read_mem_byte(cpu, cpu->funcs.user, i8086_get_physical_address(segment, offset));
 }
 static uint8_t fetch_byte(I8086_MNEM* mnem) {
 	uint8_t v = read_byte(mnem, CS, IP);
@@ -206,7 +209,7 @@ static uint8_t fetch_byte(I8086_MNEM* mnem) {
 }
 
 static uint16_t read_word(I8086_MNEM* mnem, uint16_t segment, uint16_t offset) {
-	return (((uint16_t)mnem->state->funcs.read_mem_byte(i8086_get_physical_address(segment, offset + 1)) << 8) | mnem->state->funcs.read_mem_byte(i8086_get_physical_address(segment, offset)));
+	return (((uint16_t)read_byte(mnem, segment, offset + 1) << 8) | read_byte(mnem, segment, offset));
 }
 static uint16_t fetch_word(I8086_MNEM* mnem) {
 	uint16_t v = read_word(mnem, CS, IP);
@@ -230,72 +233,28 @@ static int modrm_get_segment_index(I8086_MNEM* mnem) {
 	if (mnem->segment_prefix != 0xFF) {
 		return mnem->segment_prefix; // CS/DS/ES/SS override
 	}
-
-	// mod = 00 special case for r/m=110 -> [disp16] uses DS
-	if (mnem->modrm.mod == 0b00 && mnem->modrm.rm == 0b110) {
-		return SEG_DS;
-	}
-
-	switch (mnem->modrm.rm) {
-		case 0b010: // [BP+SI]
-		case 0b011: // [BP+DI]
-		case 0b110: // [BP] (mod != 00)
-			return SEG_SS;  // defaults to SS
-		default:
-			return SEG_DS;  // everything else defaults to DS
-	}
-}
-static uint16_t modrm_get_base_offset(I8086_MNEM* mnem) {
-	switch (mnem->modrm.rm) {
-		case 0b000: // base rel indexed - BX + SI
-			return (BX + SI);
-		case 0b001: // base rel indexed - BX + DI
-			return (BX + DI);
-		case 0b010: // base rel indexed stack - BP + SI
-			return (BP + SI);
-		case 0b011: // base rel indexed stack - BP + DI
-			return (BP + DI);
-		case 0b100: // implied SI
-			return SI;
-		case 0b101: // implied DI
-			return DI;
-		case 0b110: // implied BP
-			return BP;
-		case 0b111: // implied BX
-			return BX;
+	return i8086_modrm_ea[mnem->modrm.byte].segment; // BP based addressing defaults to SS
+}
+static uint16_t modrm_get_base_offset(I8086_MNEM* mnem, const I8086_MODRM_EA* ea) {
+	uint16_t base = 0;
+	if (ea->base != I8086_EA_NONE) {
+		base = mnem->state->registers[ea->base].r16;
 	}
-	return 0;
+	if (ea->index != I8086_EA_NONE) {
+		base += mnem->state->registers[ea->index].r16;
+	}
+	return base;
 }
 static uint16_t modrm_get_segment(I8086_MNEM* mnem) {
 	return mnem->state->segments[modrm_get_segment_index(mnem)];
 }
 
-static void modrm_get_base_offset_str(I8086_MNEM* mnem, char* t) {
-	switch (mnem->modrm.rm) {
-		case 0b000: // base rel indexed - BX + SI
-			MNEM_F(t, "%s+%s", GET_REG16(REG_BX), GET_REG16(REG_SI));
-			break;
-		case 0b001: // base rel indexed - BX + DI
-			MNEM_F(t, "%s+%s", GET_REG16(REG_BX), GET_REG16(REG_DI));
-			break;
-		case 0b010: // base rel indexed stack - BP + SI
-			MNEM_F(t, "%s+%s", GET_REG16(REG_BP), GET_REG16(REG_SI));
-			break;
-		case 0b011: // base rel indexed stack - BP + DI
-			MNEM_F(t, "%s+%s", GET_REG16(REG_BP), GET_REG16(REG_DI));
-			break;
-		case 0b100: // implied SI
-			MNEM_F(t, "%s", GET_REG16(REG_SI));
-			break;
-		case 0b101: // implied DI
-			MNEM_F(t, "%s", GET_REG16(REG_DI));
-			break;
-		case 0b110: // implied BP
-			MNEM_F(t, "%s", GET_REG16(REG_BP));
-			break;
-		case 0b111: // implied BX
-			MNEM_F(t, "%s", GET_REG16(REG_BX));
-			break;
+static void modrm_get_base_offset_str(const I8086_MODRM_EA* ea, char* t) {
+	if (ea->index != I8086_EA_NONE) {
+		MNEM_F(t, "%s+%s", GET_REG16(ea->base), GET_REG16(ea->index));
+	}
+	else {
+		MNEM_F(t, "%s", GET_REG16(ea->base));
 	}
 }
 static void modrm_get_segment_str(I8086_MNEM* mnem, char* buf, const char* fmt) {
@@ -304,44 +263,35 @@ static void modrm_get_segment_str(I8086_MNEM* mnem, char* buf, const char* fmt)
 
 void i8086_mnem_get_modrm(I8086_MNEM* mnem, char* buf, const char* fmt) {
 	// Get R/M pointer
-	switch (mnem->modrm.mod) {
-		case 0b00:
-			if (mnem->modrm.rm == 0b110) {
-				// displacement mode - [ disp16 ]
-				set_ea(mnem, modrm_get_segment(mnem), fetch_word(mnem));
-				modrm_get_segment_str(mnem, mnem->ea_str, "%s:");
-				get_unsigned_disp(mnem->ea_str, mnem->ea_offset);
-				MNEM_F(buf, fmt, mnem->ea_str);
-			}
-			else {
-				// register mode - [ base16 ]
-				set_ea(mnem, modrm_get_segment(mnem), modrm_get_base_offset(mnem));
-				modrm_get_segment_str(mnem, mnem->ea_str, "%s:");
-				modrm_get_base_offset_str(mnem, mnem->ea_str);
-				MNEM_F(buf, fmt, mnem->ea_str);
-			}
-			break;
-
-		case 0b01: {
-			// memory mode; 8bit displacement - [ base16 + disp8 ]
-			int8_t imm = fetch_byte(mnem);
-			set_ea(mnem, modrm_get_segment(mnem), modrm_get_base_offset(mnem) + imm);
-			modrm_get_segment_str(mnem, mnem->ea_str, "%s:");
-			modrm_get_base_offset_str(mnem, mnem->ea_str);
-			get_signed_disp(mnem->ea_str, imm);
-			MNEM_F(buf, fmt, mnem->ea_str);
-		} break;
-
-		case 0b10: {
-			// memory mode; 16bit displacement - [ base16 + disp16 ]
-			int16_t imm = fetch_word(mnem);
-			set_ea(mnem, modrm_get_segment(mnem), modrm_get_base_offset(mnem) + imm);
-			modrm_get_segment_str(mnem, mnem->ea_str, "%s:");
-			modrm_get_base_offset_str(mnem, mnem->ea_str);
-			get_signed_disp(mnem->ea_str, imm);
-			MNEM_F(buf, fmt, mnem->ea_str);
-		} break;
+	if (mnem->modrm.mod == 0b11) {
+		return; // register mode; no address
+	}
+	const I8086_MODRM_EA* ea = &i8086_modrm_ea[mnem->modrm.byte];
+	if (ea->base == I8086_EA_NONE) {
+		// displacement mode - [ disp16 ]
+		set_ea(mnem, modrm_get_segment(mnem), fetch_word(mnem));
+		modrm_get_segment_str(mnem, mnem->ea_str, "%s:");
+		get_unsigned_disp(mnem->ea_str, mnem->ea_offset);
+		MNEM_F(buf, fmt, mnem->ea_str);
+		return;
+	}
+
+	int16_t disp = 0;
+	switch (ea->disp_size) {
+		case 1: // memory mode; 8bit displacement - [ base16 + disp8 ]
+			disp = (int8_t)fetch_byte(mnem);
+			break;
+		case 2: // memory mode; 16bit displacement - [ base16 + disp16 ]
+			disp = (int16_t)fetch_word(mnem);
+			break;
+	}
+	set_ea(mnem, modrm_get_segment(mnem), modrm_get_base_offset(mnem, ea) + disp);
+	modrm_get_segment_str(mnem, mnem->ea_str, "%s:");
+	modrm_get_base_offset_str(ea, mnem->ea_str);
+	if (ea->disp_size != 0) {
+		get_signed_disp(mnem->ea_str, disp);
 	}
+	MNEM_F(buf, fmt, mnem->ea_str);
 }
 
 static const char* modrm_get_mnem16_nos(I8086_MNEM* mnem) {
@@ -3,12 +3,83 @@
  * Intel 8086 CPU
  */
 
+#include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "i8086.h"
 #include "i8086_alu.h"
+#include "i8086_alu_ops.h"
+#include "i8086_modrm.h"
 #include "sign_extend.h"
 
+#ifdef I8086_ENABLE_DECODE_CACHE
+#include "i8086_cache.h"
+#endif
+
+#ifdef I8086_ENABLE_SCHEDULER
+#include "i8086_sched.h"
+#endif
+
+#ifdef I8086_ENABLE_POSTED_IO
+#include "i8086_io.h"
+#endif
+
+/* SSE2 string compare kernels for the bulk rep cmps/scas (I8086_ENABLE_MEMORY_MAP) */
+#if defined(I8086_ENABLE_MEMORY_MAP) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define I8086_SSE2
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+static uint32_t CTZ32(uint32_t x) {
+	unsigned long i;
+	_BitScanForward(&i, x);
+	return (uint32_t)i;
+}
+#else
+#define CTZ32(x) ((uint32_t)__builtin_ctz(x))
+#endif
+#endif
+
+/* Compile time assert; a false condition declares a negative size array */
+#define STATIC_ASSERT(x, name) typedef char static_assert_##name[(x) ? 1 : -1]
+
+/* I8086 layout; the registers and the decode state fill the first cache line. The cold block starts on a cache line */
+STATIC_ASSERT(offsetof(I8086, registers) == 0, i8086_registers);
+STATIC_ASSERT(offsetof(I8086, prefix_cycles) + sizeof(uint32_t) <= I8086_CACHE_LINE, i8086_hot_line);
+STATIC_ASSERT(offsetof(I8086, cycles) % sizeof(uint64_t) == 0, i8086_cycles);
+STATIC_ASSERT(offsetof(I8086, intr_type) % I8086_CACHE_LINE == 0, i8086_cold_block);
+STATIC_ASSERT(sizeof(I8086) % I8086_CACHE_LINE == 0, i8086_size);
+
+/* Atomics of the async interrupt word (I8086_ENABLE_ASYNC_INTERRUPTS) */
+#ifdef I8086_ENABLE_ASYNC_INTERRUPTS
+#ifdef _MSC_VER
+#include <intrin.h>
+#define ASYNC_LOAD(p) (*(p)) // volatile; acquire on MSVC (/volatile:ms)
+#define ASYNC_EXCHANGE(p, v) _InterlockedExchange(p, v)
+#define ASYNC_OR(p, v) _InterlockedOr(p, v)
+#define ASYNC_CAS(p, expected, desired) _InterlockedCompareExchange(p, desired, expected)
+#else
+#define ASYNC_LOAD(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define ASYNC_EXCHANGE(p, v) __atomic_exchange_n(p, v, __ATOMIC_ACQ_REL)
+#define ASYNC_OR(p, v) __atomic_fetch_or(p, v, __ATOMIC_RELEASE)
+static long ASYNC_CAS(volatile long* p, long expected, long desired) {
+	__atomic_compare_exchange_n(p, &expected, desired, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+	return expected; // the value before the exchange
+}
+#endif
+
+#define ASYNC_NMI        0x01 // NMI requested
+#define ASYNC_INTR       0x02 // INTR requested; the type is in bits 8-15
+#define ASYNC_LINE       0x04 // INTR line level set
+#define ASYNC_LINE_HIGH  0x08 // INTR line level
+#define ASYNC_TYPE_SHIFT 8
+#endif
+
+#if defined(I8086_ENABLE_HOT_BLOCKS) && (!defined(I8086_ENABLE_DECODE_CACHE) || defined(I8086_DISPATCH_SWITCH))
+#error "I8086_ENABLE_HOT_BLOCKS requires I8086_ENABLE_DECODE_CACHE and table dispatch"
+#endif
+
 #define PSW cpu->status.word
 
 #define DBZ cpu->dbz
@@ -93,19 +164,29 @@
 /* Get default or override segment index */
 #define GET_SEG_OVERRIDE(seg) ((cpu->segment_prefix != 0xFF) ? cpu->segment_prefix : seg)
 
-/* Get default or override segment register */
-#define SEG_DEFAULT_OR_OVERRIDE(seg) (cpu->segments[GET_SEG_OVERRIDE(seg)])
+/* Get default or override segment base address */
+#define SEG_BASE_DEFAULT_OR_OVERRIDE(seg) (cpu->segment_bases[GET_SEG_OVERRIDE(seg)])
 
 /* Read byte from IO port */
-#define READ_IO_BYTE(port) cpu->funcs.read_io_byte(port)
+#define READ_IO_BYTE(port) cpu->funcs.read_io_byte(cpu, cpu->funcs.user, port)
 
 /* Write byte to IO port */
-#define WRITE_IO_BYTE(port,value) cpu->funcs.write_io_byte(port, value)
+#define WRITE_IO_BYTE(port,value) cpu->funcs.write_io_byte(cpu, cpu->funcs.user, port, value)
+
+/* Page is mapped to host memory */
+#ifdef I8086_ENABLE_MEMORY_MAP
+#define READ_MAPPED(addr) (cpu->read_pages[((addr) & 0xFFFFF) >> I8086_PAGE_SHIFT] != NULL)
+#define WRITE_MAPPED(addr) (cpu->write_pages[((addr) & 0xFFFFF) >> I8086_PAGE_SHIFT] != NULL)
+#else
+#define READ_MAPPED(addr) 0
+#define WRITE_MAPPED(addr) 0
+#endif
 
-/* Get ptr to 16bit segment */
-#define GET_SEG(seg) (&cpu->segments[seg & 3])
+/* Get segment base address (segment << 4) */
+#define SEG_BASE(seg) cpu->segment_bases[seg]
 
 #define TRANSFERS(x) cpu->cycles += (x * 4)
+#define PREFIX_CYCLES(x) { cpu->cycles += x; cpu->prefix_cycles += x; }
 #define TRANSFERS_RM(reg_transfer, mem_transfer) cpu->cycles += ((cpu->modrm.mod == 0b11 ? reg_transfer : mem_transfer) * 4)
 #define TRANSFERS_RM_D(reg_transfer, mr_transfer, rm_transfer) cpu->cycles += ((cpu->modrm.mod == 0b11 ? reg_transfer : !D ? mr_transfer : rm_transfer) * 4)
 
@@ -131,7 +212,7 @@ typedef struct {
 	union {
 		uint8_t reg_index;
 		struct {
-			uint16_t segment;
+			uint20_t base;
 			uint16_t offset;
 		} mem;
 	} u;
@@ -143,7 +224,7 @@ typedef struct {
 	union {
 		uint8_t reg_index;
 		struct {
-			uint16_t segment;
+			uint20_t base;
 			uint16_t offset;
 		} mem;
 	} u;
@@ -155,74 +236,265 @@ static void op8_write(I8086* cpu, OPERAND8 op8, uint8_t v);
 static uint16_t op16_read(I8086* cpu, OPERAND16 op16);
 static void op16_write(I8086* cpu, OPERAND16 op16, uint16_t v);
 
-static uint8_t read_byte(I8086* cpu, uint16_t segment, uint16_t offset) {
-	return cpu->funcs.read_mem_byte(i8086_get_physical_address(segment, offset));
+static void seg_write(I8086* cpu, uint8_t seg, uint16_t v);
+
+static int i8086_check_breakpoints(I8086* cpu);
+
+static uint8_t read_byte(I8086* cpu, uint20_t base, uint16_t offset) {
+	uint20_t addr = I8086_BASE_ADDRESS(base, offset);
+#ifdef I8086_ENABLE_MEMORY_MAP
+	uint8_t* page = cpu->read_pages[addr >> I8086_PAGE_SHIFT];
+	if (page != NULL) {
+		return page[addr & I8086_PAGE_MASK];
+	}
+#endif
+	return cpu->funcs.read_mem_byte(cpu, cpu->funcs.user, addr);
 }
-static void write_byte(I8086* cpu, uint16_t segment, uint16_t offset, uint8_t value) {
-	cpu->funcs.write_mem_byte(i8086_get_physical_address(segment, offset), value);
+static void write_byte(I8086* cpu, uint20_t base, uint16_t offset, uint8_t value) {
+	uint20_t addr = I8086_BASE_ADDRESS(base, offset);
+#ifdef I8086_ENABLE_MEMORY_MAP
+	uint8_t* page = cpu->write_pages[addr >> I8086_PAGE_SHIFT];
+	if (page != NULL) {
+		page[addr & I8086_PAGE_MASK] = value;
+	}
+	else {
+		cpu->funcs.write_mem_byte(cpu, cpu->funcs.user, addr, value);
+	}
+#else
+	cpu->funcs.write_mem_byte(cpu, cpu->funcs.user, addr, value);
+#endif
+#ifdef I8086_ENABLE_DECODE_CACHE
+	if (cpu->cache != NULL) {
+		i8086_cache_write(cpu->cache, addr);
+	}
+#endif
 }
 static uint8_t fetch_byte(I8086* cpu) {
-	uint8_t v = read_byte(cpu, CS, IP);
+	uint8_t v;
+#ifdef I8086_ENABLE_DECODE_CACHE
+	if (cpu->cache_ptr < cpu->cache_end) {
+		/* cache hit */
+		v = *cpu->cache_ptr++;
+	}
+	else {
+		v = read_byte(cpu, SEG_BASE(SEG_CS), IP);
+		if (cpu->cache != NULL && cpu->cache->recording) {
+			if (cpu->cache->record_len < I8086_CACHE_MAX_LEN) {
+				cpu->cache->record_bytes[cpu->cache->record_len] = v;
+			}
+			cpu->cache->record_len++;
+		}
+	}
+#else
+	v = read_byte(cpu, SEG_BASE(SEG_CS), IP);
+#endif
 	IP += 1;
 	cpu->instruction_len += 1;
 	return v;
 }
 
-static uint16_t read_word(I8086* cpu, uint16_t segment, uint16_t offset) {
-	return (((uint16_t)cpu->funcs.read_mem_byte(i8086_get_physical_address(segment, offset + 1)) << 8) | cpu->funcs.read_mem_byte(i8086_get_physical_address(segment, offset)));
+static uint16_t read_word(I8086* cpu, uint20_t base, uint16_t offset) {
+#ifdef I8086_ENABLE_MEMORY_MAP
+	/* both bytes in the same mapped page; the offset and the address dont wrap */
+	uint20_t addr = I8086_BASE_ADDRESS(base, offset);
+	uint8_t* page = cpu->read_pages[addr >> I8086_PAGE_SHIFT];
+	if (page != NULL && offset != 0xFFFF && (addr & I8086_PAGE_MASK) != I8086_PAGE_MASK) {
+		uint8_t* p = page + (addr & I8086_PAGE_MASK);
+		return ((uint16_t)p[1] << 8) | p[0];
+	}
+#endif
+	/* word callback; the access doesnt wrap the offset or the 1MB address space */
+	if (cpu->funcs.read_mem_word != NULL && offset != 0xFFFF) {
+		uint20_t word_addr = I8086_BASE_ADDRESS(base, offset);
+		if (word_addr != 0xFFFFF && !READ_MAPPED(word_addr) && !READ_MAPPED(word_addr + 1)) {
+			return cpu->funcs.read_mem_word(cpu, cpu->funcs.user, word_addr);
+		}
+	}
+	return (((uint16_t)read_byte(cpu, base, offset + 1) << 8) | read_byte(cpu, base, offset));
+}
+static void write_word(I8086* cpu, uint20_t base, uint16_t offset, uint16_t value) {
+	/* word callback; the access doesnt wrap the offset or the 1MB address space */
+	if (cpu->funcs.write_mem_word != NULL && offset != 0xFFFF) {
+		uint20_t addr = I8086_BASE_ADDRESS(base, offset);
+		if (addr != 0xFFFFF && !WRITE_MAPPED(addr) && !WRITE_MAPPED(addr + 1)) {
+			cpu->funcs.write_mem_word(cpu, cpu->funcs.user, addr, value);
+#ifdef I8086_ENABLE_DECODE_CACHE
+			if (cpu->cache != NULL) {
+				i8086_cache_write(cpu->cache, addr);
+				i8086_cache_write(cpu->cache, addr + 1);
+			}
+#endif
+			return;
+		}
+	}
+	write_byte(cpu, base, offset, value & 0xFF);
+	write_byte(cpu, base, offset + 1, (value >> 8) & 0xFF);
+}
+
+/* Port is posted; writes go to the device thread (I8086_ENABLE_POSTED_IO) */
+#ifdef I8086_ENABLE_POSTED_IO
+#define IO_POSTED(port) (cpu->posted_io != NULL && i8086_io_is_posted(cpu->posted_io, port))
+#endif
+
+static uint8_t read_io_byte(I8086* cpu, uint16_t port) {
+#ifdef I8086_ENABLE_POSTED_IO
+	if (IO_POSTED(port)) {
+		i8086_io_sync(cpu->posted_io);
+	}
+#endif
+	return READ_IO_BYTE(port);
 }
-static void write_word(I8086* cpu, uint16_t segment, uint16_t offset, uint16_t value) {
-	cpu->funcs.write_mem_byte(i8086_get_physical_address(segment, offset), value & 0xFF);
-	cpu->funcs.write_mem_byte(i8086_get_physical_address(segment, offset + 1), (value >> 8) & 0xFF);
+static void write_io_byte(I8086* cpu, uint16_t port, uint8_t value) {
+#ifdef I8086_ENABLE_POSTED_IO
+	if (IO_POSTED(port)) {
+		i8086_io_post(cpu->posted_io, port, value, 0);
+		return;
+	}
+#endif
+	WRITE_IO_BYTE(port, value);
+}
+static uint16_t read_io_word(I8086* cpu, uint16_t port) {
+#ifdef I8086_ENABLE_POSTED_IO
+	if (IO_POSTED(port) || IO_POSTED(port + 1)) {
+		i8086_io_sync(cpu->posted_io);
+	}
+#endif
+	if (cpu->funcs.read_io_word != NULL && port != 0xFFFF) {
+		return cpu->funcs.read_io_word(cpu, cpu->funcs.user, port);
+	}
+	return (READ_IO_BYTE(port) | (READ_IO_BYTE(port + 1) << 8));
+}
+static void write_io_word(I8086* cpu, uint16_t port, uint16_t value) {
+#ifdef I8086_ENABLE_POSTED_IO
+	/* either byte is posted; the whole word goes to the device thread */
+	if (IO_POSTED(port) || IO_POSTED(port + 1)) {
+		i8086_io_post(cpu->posted_io, port, value, 1);
+		return;
+	}
+#endif
+	if (cpu->funcs.write_io_word != NULL && port != 0xFFFF) {
+		cpu->funcs.write_io_word(cpu, cpu->funcs.user, port, value);
+		return;
+	}
+	WRITE_IO_BYTE(port, value & 0xFF);
+	WRITE_IO_BYTE(port + 1, (value >> 8) & 0xFF);
 }
 static uint16_t fetch_word(I8086* cpu) {
-	uint16_t v = read_word(cpu, CS, IP);
+#ifdef I8086_ENABLE_DECODE_CACHE
+	/* byte fetches so the word is recorded/replayed by the decode cache */
+	uint16_t v = fetch_byte(cpu);
+	v |= (uint16_t)fetch_byte(cpu) << 8;
+#else
+	uint16_t v = read_word(cpu, SEG_BASE(SEG_CS), IP);
 	IP += 2;
 	cpu->instruction_len += 2;
+#endif
 	return v;
 }
 
 static void push_op8(I8086* cpu, OPERAND8 op8) {
 	SP -= 2;
 	uint8_t tmp = op8_read(cpu, op8);
-	write_byte(cpu, SS, SP, tmp);
+	write_byte(cpu, SEG_BASE(SEG_SS), SP, tmp);
 }
 static void push_byte(I8086* cpu, uint8_t value) {
 	SP -= 2;
-	write_byte(cpu, SS, SP, value);
+	write_byte(cpu, SEG_BASE(SEG_SS), SP, value);
 }
 
 static void push_op16(I8086* cpu, OPERAND16 op16) {
 	SP -= 2;
 	uint16_t tmp = op16_read(cpu, op16);
-	write_word(cpu, SS, SP, tmp);
+	write_word(cpu, SEG_BASE(SEG_SS), SP, tmp);
 }
 static void push_word(I8086* cpu, uint16_t value) {
 	SP -= 2;
-	write_word(cpu, SS, SP, value);
+	write_word(cpu, SEG_BASE(SEG_SS), SP, value);
 }
 
 static void pop_op16(I8086* cpu, OPERAND16 op16) {
-	uint16_t tmp = read_word(cpu, SS, SP);
+	uint16_t tmp = read_word(cpu, SEG_BASE(SEG_SS), SP);
 	SP += 2;
 	op16_write(cpu, op16, tmp);
 }
 static void pop_word(I8086* cpu, uint16_t* value) {
-	*value = read_word(cpu, SS, SP);
+	*value = read_word(cpu, SEG_BASE(SEG_SS), SP);
+	SP += 2;
+}
+static void pop_seg_word(I8086* cpu, uint8_t seg) {
+	seg_write(cpu, seg, read_word(cpu, SEG_BASE(SEG_SS), SP));
 	SP += 2;
 }
 
 void i8086_intr(I8086* cpu, uint8_t type) {
-	if (!INTR) {
-		INTR = 1;
+	if (!cpu->intr_edge) {
+		cpu->intr_edge = 1;
 		cpu->intr_type = type;
+		INTR = 1;
+		cpu->pending |= I8086_PENDING_INTR;
+	}
+}
+void i8086_set_intr_line(I8086* cpu, uint8_t level) {
+	/* the pin is the line or a latched i8086_intr() request; lowering the line keeps the latch */
+	cpu->intr_line = (level != 0);
+	INTR = cpu->intr_line | cpu->intr_edge;
+	if (INTR) {
+		cpu->pending |= I8086_PENDING_INTR;
 	}
 }
 void i8086_nmi(I8086* cpu) {
 	NMI = 1;
+	cpu->pending |= I8086_PENDING_NMI;
+}
+
+#ifdef I8086_ENABLE_ASYNC_INTERRUPTS
+void i8086_async_intr(I8086* cpu, uint8_t type) {
+	long old = ASYNC_LOAD(&cpu->async_events);
+	for (;;) {
+		if (old & ASYNC_INTR) {
+			return; // a request is already waiting; dropped like i8086_intr()
+		}
+		long v = old | ASYNC_INTR | ((long)type << ASYNC_TYPE_SHIFT);
+		long prev = ASYNC_CAS(&cpu->async_events, old, v);
+		if (prev == old) {
+			return;
+		}
+		old = prev;
+	}
+}
+void i8086_async_set_intr_line(I8086* cpu, uint8_t level) {
+	long old = ASYNC_LOAD(&cpu->async_events);
+	for (;;) {
+		long v = (old & ~ASYNC_LINE_HIGH) | ASYNC_LINE | (level ? ASYNC_LINE_HIGH : 0);
+		long prev = ASYNC_CAS(&cpu->async_events, old, v);
+		if (prev == old) {
+			return;
+		}
+		old = prev;
+	}
+}
+void i8086_async_nmi(I8086* cpu) {
+	ASYNC_OR(&cpu->async_events, ASYNC_NMI);
+}
+
+/* Take the interrupts posted by other threads */
+static void i8086_async_poll(I8086* cpu) {
+	long events = ASYNC_EXCHANGE(&cpu->async_events, 0);
+	if (events & ASYNC_LINE) {
+		i8086_set_intr_line(cpu, (events & ASYNC_LINE_HIGH) != 0);
+	}
+	if (events & ASYNC_INTR) {
+		i8086_intr(cpu, (uint8_t)(events >> ASYNC_TYPE_SHIFT));
+	}
+	if (events & ASYNC_NMI) {
+		i8086_nmi(cpu);
+	}
 }
+#endif
 void i8086_int(I8086* cpu, uint8_t type) {
 
+	SYNC_FLAGS();
+
 #ifdef I8086_ENABLE_INTERRUPT_HOOKS
 	I8086_INT_CB hook = i8086_find_interrupt_cb(cpu, type);
 	if (hook != NULL) {
@@ -236,35 +508,68 @@ void i8086_int(I8086* cpu, uint8_t type) {
 	push_word(cpu, CS);
 	push_word(cpu, IP);
 	uint16_t offset = type * 4;
-	IP = read_word(cpu, 0x0000, offset);
-	CS = read_word(cpu, 0x0000, offset + 2);
+	IP = read_word(cpu, 0x00000, offset);
+	seg_write(cpu, SEG_CS, read_word(cpu, 0x00000, offset + 2));
 	IF = 0;
 	TF = 0;
+	cpu->pending |= I8086_PENDING_LATCH;
+}
+
+/* Work out the pending events from the interrupt state. INTR is only pending
+	while IF or the int latch can let it through; sti/popf/iret set I8086_PENDING_LATCH */
+static void i8086_update_pending(I8086* cpu) {
+	uint8_t pending = 0;
+	if (NMI) {
+		pending |= I8086_PENDING_NMI;
+	}
+	if (INTR && (IF || cpu->int_latch)) {
+		pending |= I8086_PENDING_INTR;
+	}
+	if (cpu->int_delay) {
+		pending |= I8086_PENDING_DELAY;
+	}
+	if (TF || cpu->tf_latch || cpu->int_latch != IF) {
+		pending |= I8086_PENDING_LATCH;
+	}
+	cpu->pending = pending;
 }
+
+/* Handle the pending events. Only called when cpu->pending is set; otherwise
+	there is no interrupt to take and the latches already hold IF/TF */
 static void i8086_check_interrupts(I8086* cpu) {
 		
 	if (cpu->int_delay == 1) {
 		cpu->int_delay = 0;
+		i8086_update_pending(cpu);
 		return;
 	}
 
 	if (NMI) {
 		/* Non-Maskable int */
 		NMI = 0;
+		cpu->halted = 0;
 		i8086_int(cpu, INT_NMI);
 		TRANSFERS(5);
 		CYCLES(50);
 	}
 	else if (INTR && cpu->int_latch) {
-		/* Hardware int; INTR is masked by IF */
-		INTR = 0;
-		i8086_int(cpu, cpu->intr_type);
+		/* Hardware int; INTR is masked by IF. The acknowledge takes the latched
+		   request; a level triggered line stays up */
+		uint8_t type = cpu->intr_type;
+		cpu->intr_edge = 0;
+		INTR = cpu->intr_line;
+		cpu->halted = 0;
+		if (cpu->funcs.inta != NULL) {
+			type = cpu->funcs.inta(cpu, cpu->funcs.user);
+		}
+		i8086_int(cpu, type);
 		TRANSFERS(7);
 		CYCLES(61);
 	}
 
 	if (cpu->tf_latch) {
 		/* Trap int */
+		cpu->halted = 0;
 		i8086_int(cpu, INT_TRAP);
 		TRANSFERS(5);
 		CYCLES(50);
@@ -275,6 +580,8 @@ static void i8086_check_interrupts(I8086* cpu) {
 
 	/* latch trap flag for next cycle */
 	cpu->tf_latch = TF;
+
+	i8086_update_pending(cpu);
 }
 
 static uint8_t reg8_read(I8086* cpu, uint8_t reg) {
@@ -294,6 +601,11 @@ static void reg8_write(I8086* cpu, uint8_t reg, uint8_t v) {
 	}
 }
 
+static void seg_write(I8086* cpu, uint8_t seg, uint16_t v) {
+	cpu->segments[seg] = v;
+	SEG_BASE(seg) = I8086_SEGMENT_BASE(v);
+}
+
 static uint16_t reg16_read(I8086* cpu, uint8_t reg) {
 	return cpu->registers[reg & 0x7].r16;
 }
@@ -303,82 +615,43 @@ static void reg16_write(I8086* cpu, uint8_t reg, uint16_t v) {
 
 /* Mod R/M */
 
-/* Use the mod r/m byte to calculate a 16bit indirect address eg (BX+SI) */
-static uint16_t modrm_get_base_offset(I8086* cpu) {
-	switch (cpu->modrm.rm) {
-		case 0b000: // base rel indexed - BX + SI
-			return (BX + SI);
-		case 0b001: // base rel indexed - BX + DI
-			return (BX + DI);
-		case 0b010: // base rel indexed stack - BP + SI
-			return (BP + SI);
-		case 0b011: // base rel indexed stack - BP + DI
-			return (BP + DI);
-		case 0b100: // implied SI
-			return SI;
-		case 0b101: // implied DI
-			return DI;
-		case 0b110: // implied BP
-			return BP;
-		case 0b111: // implied BX
-			return BX;
-	}
-	return 0;
+/* Use the mod r/m descriptor to calculate a 16bit indirect address eg (BX+SI) */
+static uint16_t modrm_get_base_offset(I8086* cpu, const I8086_MODRM_EA* ea) {
+	uint16_t base = cpu->registers[ea->base & 0x7].r16;
+	uint16_t index = cpu->registers[ea->index & 0x7].r16;
+	return (ea->base != I8086_EA_NONE ? base : 0) + (ea->index != I8086_EA_NONE ? index : 0);
 }
 
-/* Use the mod r/m byte to calculate the selected segment */
-static uint16_t modrm_get_segment(I8086* cpu) {
+/* Use the mod r/m byte to calculate the selected segment; returns the segment base address */
+static uint20_t modrm_get_segment_base(I8086* cpu) {
+	uint8_t seg;
 	if (cpu->segment_prefix != 0xFF) {
-		cpu->ea_segment = cpu->segments[cpu->segment_prefix & 0x3]; // CS/DS/ES/SS override
+		seg = cpu->segment_prefix & 0x3; // CS/DS/ES/SS override
 	}
 	else {
-		// mod = 00 special case for r/m=110 -> [disp16] uses DS
-		if (cpu->modrm.mod == 0b00 && cpu->modrm.rm == 0b110) {
-			cpu->ea_segment = cpu->segments[SEG_DS];
-		}
-		else {
-			switch (cpu->modrm.rm) {
-				case 0b010: // [BP+SI]
-				case 0b011: // [BP+DI]
-				case 0b110: // [BP] (mod != 00)
-					cpu->ea_segment = cpu->segments[SEG_SS]; // defaults to SS
-					break;
-				default:
-					cpu->ea_segment = cpu->segments[SEG_DS]; // everything else defaults to DS
-					break;
-			}
-		}
+		seg = i8086_modrm_ea[cpu->modrm.byte].segment; // BP based addressing defaults to SS
 	}
-	return cpu->ea_segment;
+	cpu->ea_segment = cpu->segments[seg];
+	return SEG_BASE(seg);
 }
 
 /* Use the mod r/m byte to calculate a 16-bit address (offset) */
 static uint16_t modrm_get_offset(I8086* cpu) {
-	switch (cpu->modrm.mod) {
-		case 0b00:
-			if (cpu->modrm.rm == 0b110) {
-				cpu->ea_offset = fetch_word(cpu);
-				CYCLES(6);
-			}
-			else {
-				cpu->ea_offset = modrm_get_base_offset(cpu);
-			}
+	if (cpu->modrm.mod == 0b11) {
+		return cpu->ea_offset; // register mode; LEA/LES/LDS use the last calculated address
+	}
+	const I8086_MODRM_EA* ea = &i8086_modrm_ea[cpu->modrm.byte];
+	uint16_t offset = modrm_get_base_offset(cpu, ea);
+	switch (ea->disp_size) {
+		case 1:
+			offset += (int8_t)fetch_byte(cpu);
+			break;
+		case 2:
+			offset += fetch_word(cpu);
 			break;
-
-		case 0b01: {
-			int8_t disp8 = (int8_t)fetch_byte(cpu);
-			cpu->ea_offset = (modrm_get_base_offset(cpu) + disp8) & 0xFFFF;
-			CYCLES(4);
-		} break;
-
-		case 0b10: {
-			int16_t disp16 = (int16_t)fetch_word(cpu);
-			cpu->ea_offset = (modrm_get_base_offset(cpu) + disp16) & 0xFFFF;
-			CYCLES(4);
-		} break;
-
-		// case 0b11: register mode never calls this
 	}
+	cpu->ea_offset = offset;
+	CYCLES(ea->cycles);
 	return cpu->ea_offset;
 }
 
@@ -390,15 +663,15 @@ static OPERAND8 modrm_get_op8(I8086* cpu) {
 	}
 	else {
 		op8.is_reg = 0;
-		op8.u.mem.segment = modrm_get_segment(cpu);
+		op8.u.mem.base = modrm_get_segment_base(cpu);
 		op8.u.mem.offset = modrm_get_offset(cpu);
 	}
 	return op8;
 }
-static OPERAND8 mem_get_op8(uint16_t segment, uint16_t offset) {
+static OPERAND8 mem_get_op8(uint20_t base, uint16_t offset) {
 	OPERAND8 op8 = { 0 };
 	op8.is_reg = 0;
-	op8.u.mem.segment = segment;
+	op8.u.mem.base = base;
 	op8.u.mem.offset = offset;
 	return op8;
 }
@@ -407,7 +680,7 @@ static uint8_t op8_read(I8086* cpu, OPERAND8 op8) {
 		return reg8_read(cpu, op8.u.reg_index);
 	}
 	else {
-		return read_byte(cpu, op8.u.mem.segment, op8.u.mem.offset);
+		return read_byte(cpu, op8.u.mem.base, op8.u.mem.offset);
 	}
 }
 static void op8_write(I8086* cpu, OPERAND8 op8, uint8_t v) {
@@ -415,38 +688,10 @@ static void op8_write(I8086* cpu, OPERAND8 op8, uint8_t v) {
 		reg8_write(cpu, op8.u.reg_index, v);
 	}
 	else {
-		write_byte(cpu, op8.u.mem.segment, op8.u.mem.offset, v);
+		write_byte(cpu, op8.u.mem.base, op8.u.mem.offset, v);
 	}
 }
 
-// Resolve bit8 ModR/M + reg with D bit, then execute a binary op. with writeback
-// The op must be of the form: void op(I8086*, uint8_t*, uint8_t);
-static void exec_bin_op8(I8086* cpu, void (*op)(I8086*, uint8_t*, uint8_t)) {
-	OPERAND8 rm = modrm_get_op8(cpu);
-	uint8_t reg = reg8_read(cpu, cpu->modrm.reg);
-	uint8_t tmp = op8_read(cpu, rm);
-	if (D) {
-		op(cpu, &reg, tmp);
-		reg8_write(cpu, cpu->modrm.reg, reg);
-	}
-	else {
-		op(cpu, &tmp, reg);
-		op8_write(cpu, rm, tmp);
-	}
-}
-// Resolve bit8 ModR/M + reg with D bit, then execute a binary op. no writeback
-// The op must be of the form: void op(I8086*, uint8_t, uint8_t);
-static void exec_bin_op8_ro(I8086* cpu, void (*op)(I8086*, uint8_t, uint8_t)) {
-	OPERAND8 rm = modrm_get_op8(cpu);
-	uint8_t reg = reg8_read(cpu, cpu->modrm.reg);
-	uint8_t tmp = op8_read(cpu, rm);
-	if (D) {
-		op(cpu, reg, tmp);
-	}
-	else {
-		op(cpu, tmp, reg);
-	}
-}
 
 static OPERAND16 modrm_get_op16(I8086* cpu) {
 	OPERAND16 op16 = { 0 };
@@ -456,15 +701,15 @@ static OPERAND16 modrm_get_op16(I8086* cpu) {
 	}
 	else {
 		op16.is_reg = 0;
-		op16.u.mem.segment = modrm_get_segment(cpu);
+		op16.u.mem.base = modrm_get_segment_base(cpu);
 		op16.u.mem.offset = modrm_get_offset(cpu);
 	}
 	return op16;
 }
-static OPERAND16 mem_get_op16(uint16_t segment, uint16_t offset) {
+static OPERAND16 mem_get_op16(uint20_t base, uint16_t offset) {
 	OPERAND16 op16 = { 0 };
 	op16.is_reg = 0;
-	op16.u.mem.segment = segment;
+	op16.u.mem.base = base;
 	op16.u.mem.offset = offset;
 	return op16;
 }
@@ -473,7 +718,7 @@ static uint16_t op16_read(I8086* cpu, OPERAND16 op16) {
 		return reg16_read(cpu, op16.u.reg_index);
 	}
 	else {
-		return read_word(cpu, op16.u.mem.segment, op16.u.mem.offset);
+		return read_word(cpu, op16.u.mem.base, op16.u.mem.offset);
 	}
 }
 static void op16_write(I8086* cpu, OPERAND16 op16, uint16_t v) {
@@ -481,36 +726,7 @@ static void op16_write(I8086* cpu, OPERAND16 op16, uint16_t v) {
 		reg16_write(cpu, op16.u.reg_index, v);
 	}
 	else {
-		write_word(cpu, op16.u.mem.segment, op16.u.mem.offset, v);
-	}
-}
-
-// Resolve bit16 ModR/M + reg with D bit, then execute a binary op. with writeback
-// The op must be of the form: void op(I8086*, uint16_t*, uint16_t);
-static void exec_bin_op16(I8086* cpu, void (*op)(I8086*, uint16_t*, uint16_t)) {
-	OPERAND16 rm = modrm_get_op16(cpu);
-	uint16_t reg = reg16_read(cpu, cpu->modrm.reg);
-	uint16_t tmp = op16_read(cpu, rm);
-	if (D) {
-		op(cpu, &reg, tmp);
-		reg16_write(cpu, cpu->modrm.reg, reg);
-	}
-	else {
-		op(cpu, &tmp, reg);
-		op16_write(cpu, rm, tmp);
-	}
-}
-// Resolve bit16 ModR/M + reg with D bit, then execute a binary op. no writeback
-// The op must be of the form: void op(I8086*, uint16_t, uint16_t);
-static void exec_bin_op16_ro(I8086* cpu, void (*op)(I8086*, uint16_t, uint16_t)) {
-	OPERAND16 rm = modrm_get_op16(cpu);
-	uint16_t reg = reg16_read(cpu, cpu->modrm.reg);
-	uint16_t tmp = op16_read(cpu, rm);
-	if (D) {
-		op(cpu, reg, tmp);
-	}
-	else {
-		op(cpu, tmp, reg);
+		write_word(cpu, op16.u.mem.base, op16.u.mem.offset, v);
 	}
 }
 
@@ -518,6 +734,85 @@ static void fetch_modrm(I8086* cpu) {
 	cpu->modrm.byte = fetch_byte(cpu);
 }
 
+/* Specialised r/m, reg handlers of the binary alu ops (00-3B, 84/85). A routine
+	is stamped out per op, width and direction with the alu op inlined; the
+	register and memory forms are split on mod. X(name, op8, op16, writeback) */
+#define ALU_RM_REG_OPS(X) \
+	X(add, ALU_ADD8, ALU_ADD16, 1) \
+	X(or,  ALU_OR8,  ALU_OR16,  1) \
+	X(adc, ALU_ADC8, ALU_ADC16, 1) \
+	X(sbb, ALU_SBB8, ALU_SBB16, 1) \
+	X(and, ALU_AND8, ALU_AND16, 1) \
+	X(sub, ALU_SUB8, ALU_SUB16, 1) \
+	X(xor, ALU_XOR8, ALU_XOR16, 1) \
+	X(cmp, ALU_SUB8, ALU_SUB16, 0)
+
+/* op r/m, reg (D = 0) */
+#define ALU_RM_REG(name, T, op, wb, reg_read, reg_write, mem_read, mem_write) \
+static void name(I8086* cpu) { \
+	fetch_modrm(cpu); \
+	T reg = reg_read(cpu, cpu->modrm.reg); \
+	if (cpu->modrm.mod == 0b11) { \
+		T tmp = reg_read(cpu, cpu->modrm.rm); \
+		op(tmp, reg); \
+		if (wb) { \
+			reg_write(cpu, cpu->modrm.rm, tmp); \
+		} \
+		CYCLES(3); \
+	} \
+	else { \
+		uint20_t base = modrm_get_segment_base(cpu); \
+		uint16_t offset = modrm_get_offset(cpu); \
+		T tmp = mem_read(cpu, base, offset); \
+		op(tmp, reg); \
+		if (wb) { \
+			mem_write(cpu, base, offset, tmp); \
+			TRANSFERS(2); \
+			CYCLES(16); \
+		} \
+		else { \
+			TRANSFERS(1); \
+			CYCLES(9); \
+		} \
+	} \
+}
+
+/* op reg, r/m (D = 1) */
+#define ALU_REG_RM(name, T, op, wb, reg_read, reg_write, mem_read) \
+static void name(I8086* cpu) { \
+	fetch_modrm(cpu); \
+	T reg = reg_read(cpu, cpu->modrm.reg); \
+	T tmp = 0; \
+	if (cpu->modrm.mod == 0b11) { \
+		tmp = reg_read(cpu, cpu->modrm.rm); \
+		op(reg, tmp); \
+		CYCLES(3); \
+	} \
+	else { \
+		uint20_t base = modrm_get_segment_base(cpu); \
+		uint16_t offset = modrm_get_offset(cpu); \
+		tmp = mem_read(cpu, base, offset); \
+		op(reg, tmp); \
+		TRANSFERS(1); \
+		CYCLES(9); \
+	} \
+	if (wb) { \
+		reg_write(cpu, cpu->modrm.reg, reg); \
+	} \
+}
+
+#define ALU_RM_REG_HANDLERS(name, op8, op16, wb) \
+	ALU_RM_REG(name##_rm_reg8, uint8_t, op8, wb, reg8_read, reg8_write, read_byte, write_byte) \
+	ALU_RM_REG(name##_rm_reg16, uint16_t, op16, wb, reg16_read, reg16_write, read_word, write_word) \
+	ALU_REG_RM(name##_reg_rm8, uint8_t, op8, wb, reg8_read, reg8_write, read_byte) \
+	ALU_REG_RM(name##_reg_rm16, uint16_t, op16, wb, reg16_read, reg16_write, read_word)
+
+ALU_RM_REG_OPS(ALU_RM_REG_HANDLERS)
+
+/* test r/m, reg (84/85) b1000010W */
+ALU_RM_REG(test_rm_reg8, uint8_t, ALU_AND8, 0, reg8_read, reg8_write, read_byte, write_byte)
+ALU_RM_REG(test_rm_reg16, uint16_t, ALU_AND16, 0, reg16_read, reg16_write, read_word, write_word)
+
 /* Opcodes */
 
 static void add_rm_imm(I8086* cpu) {
@@ -552,18 +847,6 @@ static void add_rm_imm(I8086* cpu) {
 	TRANSFERS_RM(0, 2);
 	CYCLES_RM(4, 17);
 }
-static void add_rm_reg(I8086* cpu) {
-	/* add r/m, reg (00/01/02/03) b000000DW */
-	fetch_modrm(cpu);
-	if (W) {
-		exec_bin_op16(cpu, alu_add16);
-	}
-	else {
-		exec_bin_op8(cpu, alu_add8);
-	}
-	TRANSFERS_RM_D(0, 2, 1);
-	CYCLES_RM_D(3, 16, 9);
-}
 static void add_accum_imm(I8086* cpu) {
 	/* add AL/AX, imm (04/05) b0000010W */
 	if (W) {
@@ -609,18 +892,6 @@ static void or_rm_imm(I8086* cpu) {
 	TRANSFERS_RM(0, 2);
 	CYCLES_RM(4, 17);
 }
-static void or_rm_reg(I8086* cpu) {
-	/* or r/m, reg (08/0A/09/0B) b000010DW */
-	fetch_modrm(cpu);
-	if (W) {
-		exec_bin_op16(cpu, alu_or16);
-	}
-	else {
-		exec_bin_op8(cpu, alu_or8);
-	}
-	TRANSFERS_RM_D(0, 2, 1);
-	CYCLES_RM_D(3, 16, 9);
-}
 static void or_accum_imm(I8086* cpu) {
 	/* or AL/AX, imm (0C/0D) b0000110W */
 	if (W) {
@@ -666,18 +937,6 @@ static void adc_rm_imm(I8086* cpu) {
 	TRANSFERS_RM(0, 2);
 	CYCLES_RM(4, 17);
 }
-static void adc_rm_reg(I8086* cpu) {
-	/* adc r/m, reg (10/12/11/13) b000100DW */
-	fetch_modrm(cpu);
-	if (W) {
-		exec_bin_op16(cpu, alu_adc16);
-	}
-	else {
-		exec_bin_op8(cpu, alu_adc8);
-	}
-	TRANSFERS_RM_D(0, 2, 1);
-	CYCLES_RM_D(3, 16, 9);
-}
 static void adc_accum_imm(I8086* cpu) {
 	/* adc AL/AX, imm (14/15) b0001010W */
 	if (W) {
@@ -723,18 +982,6 @@ static void sbb_rm_imm(I8086* cpu) {
 	TRANSFERS_RM(0, 2);
 	CYCLES_RM(4, 17);
 }
-static void sbb_rm_reg(I8086* cpu) {
-	/* sbb r/m, reg (18/1A/19/1B) b000110DW */
-	fetch_modrm(cpu);
-	if (W) {
-		exec_bin_op16(cpu, alu_sbb16);
-	}
-	else {
-		exec_bin_op8(cpu, alu_sbb8);
-	}
-	TRANSFERS_RM_D(0, 2, 1);
-	CYCLES_RM_D(3, 16, 9);
-}
 static void sbb_accum_imm(I8086* cpu) {
 	/* sbb AL/AX, imm (1C/1D) b0001110W */
 	if (W) {
@@ -780,18 +1027,6 @@ static void and_rm_imm(I8086* cpu) {
 	TRANSFERS_RM(0, 2);
 	CYCLES_RM(4, 17);
 }
-static void and_rm_reg(I8086* cpu) {
-	/* and r/m, reg (20/22/21/23) b001000DW */
-	fetch_modrm(cpu);
-	if (W) {
-		exec_bin_op16(cpu, alu_and16);
-	}
-	else {
-		exec_bin_op8(cpu, alu_and8);
-	}
-	TRANSFERS_RM_D(0, 2, 1);
-	CYCLES_RM_D(3, 16, 9);
-}
 static void and_accum_imm(I8086* cpu) {
 	/* and AL/AX, imm (24/25) b0010010W */
 	if (W) {
@@ -837,18 +1072,6 @@ static void sub_rm_imm(I8086* cpu) {
 	TRANSFERS_RM(0, 2);
 	CYCLES_RM(4, 17);
 }
-static void sub_rm_reg(I8086* cpu) {
-	/* sub r/m, reg (28/2A/29/2B) b001010DW */
-	fetch_modrm(cpu);
-	if (W) {
-		exec_bin_op16(cpu, alu_sub16);
-	}
-	else {
-		exec_bin_op8(cpu, alu_sub8);
-	}
-	TRANSFERS_RM_D(0, 2, 1);
-	CYCLES_RM_D(3, 16, 9);
-}
 static void sub_accum_imm(I8086* cpu) {
 	/* sub AL/AX, imm (2C/2D) b0010110W */
 	if (W) {
@@ -894,18 +1117,6 @@ static void xor_rm_imm(I8086* cpu) {
 	TRANSFERS_RM(0, 2);
 	CYCLES_RM(4, 17);
 }
-static void xor_rm_reg(I8086* cpu) {
-	/* xor r/m, reg (30/32/31/33) b001100DW */
-	fetch_modrm(cpu);
-	if (W) {
-		exec_bin_op16(cpu, alu_xor16);
-	}
-	else {
-		exec_bin_op8(cpu, alu_xor8);
-	}
-	TRANSFERS_RM_D(0, 2, 1);
-	CYCLES_RM_D(3, 16, 9);
-}
 static void xor_accum_imm(I8086* cpu) {
 	/* xor AL/AX, imm (34/35) b0011010W */
 	if (W) {
@@ -948,18 +1159,6 @@ static void cmp_rm_imm(I8086* cpu) {
 	TRANSFERS_RM(0, 1);
 	CYCLES_RM(4, 10);
 }
-static void cmp_rm_reg(I8086* cpu) {
-	/* cmp r/m, reg (38/39/3A/3B) b001110DW */
-	fetch_modrm(cpu);
-	if (W) {
-		exec_bin_op16_ro(cpu, alu_cmp16);
-	}
-	else {
-		exec_bin_op8_ro(cpu, alu_cmp8);
-	}
-	TRANSFERS_RM(0, 1);
-	CYCLES_RM(3, 9);
-}
 static void cmp_accum_imm(I8086* cpu) {
 	/* cmp AL/AX, imm (3C/3D) b0011110W */
 	if (W) {
@@ -989,18 +1188,6 @@ static void test_rm_imm(I8086* cpu) {
 	}
 	CYCLES_RM(5, 11);
 }
-static void test_rm_reg(I8086* cpu) {
-	/* test r/m, reg (84/85) b1000010W */
-	fetch_modrm(cpu);
-	if (W) {
-		exec_bin_op16_ro(cpu, alu_test16);
-	}
-	else {
-		exec_bin_op8_ro(cpu, alu_test8);
-	}
-	TRANSFERS_RM(0, 1);
-	CYCLES_RM(3, 9);
-}
 static void test_accum_imm(I8086* cpu) {
 	/* test AL/AX, imm (A8/A9) b1010100W */
 	if (W) {
@@ -1048,6 +1235,7 @@ static void aad(I8086* cpu) {
 }
 static void salc(I8086* cpu) {
 	/* set carry in AL (D6) b11010110 undocumented opcode */
+	SYNC_FLAGS();
 	if (CF) {
 		AL = 0xFF;
 	}
@@ -1065,7 +1253,7 @@ static void push_seg(I8086* cpu) {
 }
 static void pop_seg(I8086* cpu) {
 	/* Pop seg16 (07/0F/17/1F) b000SR111 */
-	pop_word(cpu, &cpu->segments[SR]);
+	pop_seg_word(cpu, SR);
 	TRANSFERS(1);
 	CYCLES(8);
 
@@ -1074,6 +1262,7 @@ static void pop_seg(I8086* cpu) {
 		'POP SS' instruction, data may be pushed using an incorrect stack address,
 		resulting in memory corruption. */
 	cpu->int_delay = 1;
+	cpu->pending |= I8086_PENDING_DELAY;
 }
 static void push_reg(I8086* cpu) {
 	/* Push reg16 (50-57) b01010REG */
@@ -1082,7 +1271,7 @@ static void push_reg(I8086* cpu) {
 		This is so when pushing SP the NEW SP is pushed. */
 
 	SP -= 2;
-	write_word(cpu, SS, SP, reg16_read(cpu, cpu->opcode));
+	write_word(cpu, SEG_BASE(SEG_SS), SP, reg16_read(cpu, cpu->opcode));
 	TRANSFERS(1);
 	CYCLES(11);
 }
@@ -1092,7 +1281,7 @@ static void pop_reg(I8086* cpu) {
 	/* NOTE: SP needs to be incemented after reading the value from memory.
 		This is so when popping SP the OLD SP is popped. */
 
-	uint16_t tmp = read_word(cpu, SS, SP);
+	uint16_t tmp = read_word(cpu, SEG_BASE(SEG_SS), SP);
 	SP += 2;
 	reg16_write(cpu, cpu->opcode, tmp);
 	TRANSFERS(1);
@@ -1131,6 +1320,7 @@ static void pop_rm(I8086* cpu) {
 }
 static void pushf(I8086* cpu) {
 	/* push psw (9C) b10011100 */
+	SYNC_FLAGS();
 	PSW &= 0xFFD7;
 	push_word(cpu, PSW);
 	TRANSFERS(1);
@@ -1141,6 +1331,8 @@ static void popf(I8086* cpu) {
 	uint16_t psw = 0;
 	pop_word(cpu, &psw);
 	PSW = (psw | 0xF002) & 0xFFD7;
+	DISCARD_FLAGS();
+	cpu->pending |= I8086_PENDING_LATCH; // IF/TF may have changed
 	TRANSFERS(1);
 	CYCLES(8);
 }
@@ -1209,44 +1401,51 @@ static void wait(I8086* cpu) {
 
 static void sahf(I8086* cpu) {
 	/* Store AH into flags (9E) b10011110 */
+	SYNC_FLAGS();
 	PSW &= 0xFF02; /* Mask hi byte; Clear bit 2 */
 	PSW |= AH & 0xD5;
 	CYCLES(4);
 }
 static void lahf(I8086* cpu) {
 	/* Load flags into AH (9F) b10011111 */
+	SYNC_FLAGS();
 	AH = PSW & 0xD7;
 	CYCLES(4);
 }
 
 static void hlt(I8086* cpu) {
 	/* Halt CPU (F4) b11110100 */
-	IP -= cpu->instruction_len;
+	cpu->halted = 1;
 	CYCLES(2);
 }
 static void cmc(I8086* cpu) {
 	// Complement carry flag (F5) b11110101
+	SYNC_FLAGS();
 	CF = !CF;
 	CYCLES(2);
 }
 static void clc(I8086* cpu) {
 	// clear carry flag (F8) b11111000
+	SYNC_FLAGS();
 	CF = 0;
 	CYCLES(2);
 }
 static void stc(I8086* cpu) {
 	// set carry flag (F9) b11111001
+	SYNC_FLAGS();
 	CF = 1;
 	CYCLES(2);
 }
 static void cli(I8086* cpu) {
 	// clear interrupt flag (FA) b11111010
 	IF = 0;
+	cpu->pending |= I8086_PENDING_LATCH;
 	CYCLES(2);
 }
 static void sti(I8086* cpu) {
 	// set interrupt flag (FB) b1111011
 	IF = 1;
+	cpu->pending |= I8086_PENDING_LATCH;
 	CYCLES(2);
 }
 static void cld(I8086* cpu) {
@@ -1538,6 +1737,7 @@ static void setmo(I8086* cpu) {
 }
 
 static int jump_condition(I8086* cpu) {
+	SYNC_FLAGS();
 	switch (CCCC) {
 		case JCC_JO:
 			if (OF) return 1;
@@ -1634,7 +1834,7 @@ static void jmp_inter_direct(I8086* cpu) {
 	uint16_t imm = fetch_word(cpu);
 	uint16_t imm2 = fetch_word(cpu);
 	IP = imm;
-	CS = imm2;
+	seg_write(cpu, SEG_CS, imm2);
 	CYCLES(15);
 }
 
@@ -1682,10 +1882,10 @@ static int jmp_inter_indirect(I8086* cpu) {
 			return I8086_DECODE_UNDEFINED;
 		}
 		else {
-			uint16_t segment = modrm_get_segment(cpu);
+			uint20_t base = modrm_get_segment_base(cpu);
 			uint16_t offset = modrm_get_offset(cpu);
-			IP = read_word(cpu, segment, offset);
-			CS = read_word(cpu, segment, offset + 2);
+			IP = read_word(cpu, base, offset);
+			seg_write(cpu, SEG_CS, read_word(cpu, base, offset + 2));
 		}
 	}
 	else {
@@ -1704,13 +1904,13 @@ static int jmp_inter_indirect(I8086* cpu) {
 			uint16_t offset = modrm_get_offset(cpu);
 
 			/* IP is read respecting segment override. Set the hi byte to FF. */
-			uint16_t segment = modrm_get_segment(cpu);
-			IP = 0xFF00 | read_byte(cpu, segment, offset);
+			uint20_t base = modrm_get_segment_base(cpu);
+			IP = 0xFF00 | read_byte(cpu, base, offset);
 
 			/* CS is read disregarding segment override. Set the hi byte to FF. */
 			cpu->segment_prefix = 0xFF;
-			segment = modrm_get_segment(cpu);
-			CS = 0xFF00 | read_byte(cpu, segment, offset);
+			base = modrm_get_segment_base(cpu);
+			seg_write(cpu, SEG_CS, 0xFF00 | read_byte(cpu, base, offset));
 		}
 	}
 	TRANSFERS(2);
@@ -1745,7 +1945,7 @@ static void call_inter_direct(I8086* cpu) {
 	push_word(cpu, CS);
 	push_word(cpu, IP);
 	IP = ip;
-	CS = cs;
+	seg_write(cpu, SEG_CS, cs);
 	TRANSFERS(2);
 	CYCLES(28);
 }
@@ -1802,10 +2002,10 @@ static int call_inter_indirect(I8086* cpu) {
 			return I8086_DECODE_UNDEFINED;
 		}
 		else {
-			uint16_t segment = modrm_get_segment(cpu);
+			uint20_t base = modrm_get_segment_base(cpu);
 			uint16_t offset = modrm_get_offset(cpu);
-			ip = read_word(cpu, segment, offset);
-			cs = read_word(cpu, segment, offset + 2);
+			ip = read_word(cpu, base, offset);
+			cs = read_word(cpu, base, offset + 2);
 		}
 
 		push_word(cpu, CS);
@@ -1827,13 +2027,13 @@ static int call_inter_indirect(I8086* cpu) {
 			uint16_t offset = modrm_get_offset(cpu);
 
 			/* IP is read respecting segment override. Set the hi byte to FF. */
-			uint16_t segment = modrm_get_segment(cpu);
-			ip = 0xFF00 | read_byte(cpu, segment, offset);
+			uint20_t base = modrm_get_segment_base(cpu);
+			ip = 0xFF00 | read_byte(cpu, base, offset);
 
 			/* CS is read disregarding segment override. Set the hi byte to FF. */
 			cpu->segment_prefix = 0xFF;
-			segment = modrm_get_segment(cpu);
-			cs = 0xFF00 | read_byte(cpu, segment, offset);
+			base = modrm_get_segment_base(cpu);
+			cs = 0xFF00 | read_byte(cpu, base, offset);
 		}
 
 		/* Only the lo byte of CS and IP are pushed to the stack. */
@@ -1842,7 +2042,7 @@ static int call_inter_indirect(I8086* cpu) {
 	}
 
 	IP = ip;
-	CS = cs;
+	seg_write(cpu, SEG_CS, cs);
 	TRANSFERS(4);
 	CYCLES(37);
 	return I8086_DECODE_OK;
@@ -1866,7 +2066,7 @@ static void ret_inter_add_imm(I8086* cpu) {
 	/* Ret imm16 (CA) b110010X0 - undocumented* on 8086 C8 decodes identically to CA */
 	uint16_t imm = fetch_word(cpu);
 	pop_word(cpu, &IP);
-	pop_word(cpu, &CS);
+	pop_seg_word(cpu, SEG_CS);
 	SP += imm;
 	TRANSFERS(2);
 	CYCLES(17);
@@ -1874,7 +2074,7 @@ static void ret_inter_add_imm(I8086* cpu) {
 static void ret_inter(I8086* cpu) {
 	/* Ret (CB) b110010X1 - undocumented* on 8086 C9 decodes identically to CB */
 	pop_word(cpu, &IP);
-	pop_word(cpu, &CS);
+	pop_seg_word(cpu, SEG_CS);
 	TRANSFERS(2);
 	CYCLES(18);
 }
@@ -1939,7 +2139,7 @@ static void mov_accum_mem(I8086* cpu) {
 	/* mov AL/AX, [mem] (A0/A1/A2/A3) b101000DW */
 	uint16_t addr = fetch_word(cpu);
 	if (W) {
-		OPERAND16 mem = mem_get_op16(SEG_DEFAULT_OR_OVERRIDE(SEG_DS), addr);
+		OPERAND16 mem = mem_get_op16(SEG_BASE_DEFAULT_OR_OVERRIDE(SEG_DS), addr);
 		if (D) {
 			uint16_t tmp = reg16_read(cpu, REG_AX);
 			op16_write(cpu, mem, tmp);
@@ -1950,7 +2150,7 @@ static void mov_accum_mem(I8086* cpu) {
 		}
 	}
 	else {
-		OPERAND8 mem = mem_get_op8(SEG_DEFAULT_OR_OVERRIDE(SEG_DS), addr);
+		OPERAND8 mem = mem_get_op8(SEG_BASE_DEFAULT_OR_OVERRIDE(SEG_DS), addr);
 		if (D) {
 			uint8_t tmp = reg8_read(cpu, REG_AL);
 			op8_write(cpu, mem, tmp);
@@ -1967,13 +2167,13 @@ static void mov_seg(I8086* cpu) {
 	/* mov r/m, seg (8C/8E) b100011D0 */
 	fetch_modrm(cpu);		
 	OPERAND16 rm = modrm_get_op16(cpu);
-	uint16_t* seg = GET_SEG(cpu->modrm.reg);
+	uint8_t seg = cpu->modrm.reg & 0x3;
 
 	if (D) {
-		*seg = op16_read(cpu, rm);
+		seg_write(cpu, seg, op16_read(cpu, rm));
 	}
 	else {
-		op16_write(cpu, rm, *seg);
+		op16_write(cpu, rm, cpu->segments[seg]);
 	}
 	
 	TRANSFERS_RM(0, 1);
@@ -1985,6 +2185,7 @@ static void mov_seg(I8086* cpu) {
 			'MOV SS, XXX' instruction, data may be pushed using an incorrect stack address,
 			resulting in memory corruption. */
 		cpu->int_delay = 1;
+		cpu->pending |= I8086_PENDING_DELAY;
 	}
 }
 
@@ -2107,28 +2308,90 @@ static void idiv_rm(I8086* cpu) {
 
 }
 
-static int movs(I8086* cpu) {
-	/* movs (A4/A5) b1010010W */
+/* Rep string bulk execution. After the first iteration of a rep string
+   instruction the remaining iterations run without returning to i8086_run()
+   as long as nothing could happen between them: no interrupt or trap is
+   pending or posted by another thread, no breakpoint is on the instruction
+   and the cycle budget of the run is not spent. Each iteration is charged
+   the same cycles as if it was fetched again (prefix bytes included).
+   repz/repnz cmps/scas end the instruction on the element that fails the
+   ZF check. i8086_execute() still steps one iteration. */
 
-	/* Rep prefix check */
-	if (F1) {
-		if (CX == 0) {
-			return I8086_DECODE_OK;
+/* The next iteration of a rep string instruction can run in bulk */
+static int rep_bulk_continue(I8086* cpu) {
+	if (CX == 0 || cpu->cycles >= cpu->run_end) {
+		return 0;
+	}
+	if (cpu->pending != 0) {
+		return 0; // an interrupt check is due
+	}
+#ifdef I8086_ENABLE_ASYNC_INTERRUPTS
+	if (ASYNC_LOAD(&cpu->async_events) != 0) {
+		return 0; // another thread posted an interrupt
+	}
+#endif
+	if (cpu->breakpoint_count != 0 && i8086_check_breakpoints(cpu)) {
+		return 0;
+	}
+	return 1;
+}
+
+/* A write of size bytes at base+offset (segment base address) overwrites the rep string instruction (CS:IP) */
+static int rep_bulk_writes_code(I8086* cpu, uint20_t base, uint16_t offset, uint32_t size) {
+	uint20_t code = I8086_BASE_ADDRESS(SEG_BASE(SEG_CS), IP);
+	for (uint32_t i = 0; i < size; ++i) {
+		uint20_t addr = I8086_BASE_ADDRESS(base, offset + i);
+		if (((addr - code) & 0xFFFFF) < cpu->instruction_len) {
+			return 1;
 		}
-		CX -= 1;
 	}
+	return 0;
+}
+
+/* Set the interrupt latches as the skipped interrupt checks would have */
+static void rep_bulk_end(I8086* cpu, uint32_t n) {
+	if (n != 0) {
+		cpu->int_latch = IF;
+		cpu->tf_latch = TF;
+	}
+}
 
-	/* Do string operation */
+#ifdef I8086_ENABLE_MEMORY_MAP
+/* Number of elements that can be done in one go from host memory; limited by
+   CX, the cycle budget, the page of segment:offset and the segment wrap */
+static uint32_t rep_bulk_count(I8086* cpu, uint32_t cycles, uint20_t base, uint16_t offset) {
+	uint32_t size = 1 << W;
+	uint20_t addr = I8086_BASE_ADDRESS(base, offset);
+	uint32_t count = CX;
+
+	/* iterations started before the end of the run */
+	uint64_t budget = (cpu->run_end - cpu->cycles + cycles - 1) / cycles;
+	if (budget < count) {
+		count = (uint32_t)budget;
+	}
+
+	uint32_t page_left = (I8086_PAGE_SIZE - (addr & I8086_PAGE_MASK)) / size;
+	if (page_left < count) {
+		count = page_left;
+	}
+
+	uint32_t segment_left = (0x10000 - (uint32_t)offset) / size;
+	if (segment_left < count) {
+		count = segment_left;
+	}
+	return count;
+}
+#endif
+
+static void movs_element(I8086* cpu) {
 	if (W) {
-		uint16_t src = read_word(cpu, SEG_DEFAULT_OR_OVERRIDE(SEG_DS), SI);
-		write_word(cpu, ES, DI, src);
+		uint16_t src = read_word(cpu, SEG_BASE_DEFAULT_OR_OVERRIDE(SEG_DS), SI);
+		write_word(cpu, SEG_BASE(SEG_ES), DI, src);
 	}
 	else {
-		uint8_t src = read_byte(cpu, SEG_DEFAULT_OR_OVERRIDE(SEG_DS), SI);
-		write_byte(cpu, ES, DI, src);
+		uint8_t src = read_byte(cpu, SEG_BASE_DEFAULT_OR_OVERRIDE(SEG_DS), SI);
+		write_byte(cpu, SEG_BASE(SEG_ES), DI, src);
 	}
-	TRANSFERS(2);
-	CYCLES(18);
 
 	/* Adjust si/di delta */
 	if (DF) {
@@ -2139,15 +2402,72 @@ static int movs(I8086* cpu) {
 		SI += (1 << W);
 		DI += (1 << W);
 	}
-
-	/* Rep prefix check */
-	if (F1) {
-		IP -= cpu->instruction_len; /* Allow interrupts */
+}
+static void movs_bulk(I8086* cpu) {
+#ifdef I8086_ENABLE_MEMORY_MAP
+	uint32_t cycles = cpu->prefix_cycles + 18 + (2 * 4);
+#endif
+	uint32_t n = 0;
+
+	while (rep_bulk_continue(cpu)) {
+#ifdef I8086_ENABLE_MEMORY_MAP
+		if (!DF) {
+			uint20_t base = SEG_BASE_DEFAULT_OR_OVERRIDE(SEG_DS);
+			uint20_t src_addr = I8086_BASE_ADDRESS(base, SI);
+			uint20_t dest_addr = I8086_BASE_ADDRESS(SEG_BASE(SEG_ES), DI);
+			uint8_t* src = cpu->read_pages[src_addr >> I8086_PAGE_SHIFT];
+			uint8_t* dest = cpu->write_pages[dest_addr >> I8086_PAGE_SHIFT];
+			uint32_t count = rep_bulk_count(cpu, cycles, base, SI);
+			uint32_t dest_count = rep_bulk_count(cpu, cycles, SEG_BASE(SEG_ES), DI);
+			if (dest_count < count) {
+				count = dest_count;
+			}
+			uint32_t size = count << W;
+			if (src != NULL && dest != NULL && count != 0 && !rep_bulk_writes_code(cpu, SEG_BASE(SEG_ES), DI, size)) {
+				src += src_addr & I8086_PAGE_MASK;
+				dest += dest_addr & I8086_PAGE_MASK;
+				if (dest <= src || dest >= src + size) {
+					memmove(dest, src, size);
+				}
+				else {
+					/* dest overlaps the end of src; copy element by element to repeat the pattern */
+					for (uint32_t i = 0; i < size; i += (1 << W)) {
+						uint8_t lo = src[i];
+						uint8_t hi = W ? src[i + 1] : 0;
+						dest[i] = lo;
+						if (W) {
+							dest[i + 1] = hi;
+						}
+					}
+				}
+#ifdef I8086_ENABLE_DECODE_CACHE
+				if (cpu->cache != NULL) {
+					i8086_cache_invalidate(cpu->cache, dest_addr, size);
+				}
+#endif
+				CX -= count;
+				SI += size;
+				DI += size;
+				cpu->cycles += (uint64_t)count * cycles;
+				n += count;
+				continue;
+			}
+		}
+#endif
+		if (rep_bulk_writes_code(cpu, SEG_BASE(SEG_ES), DI, 1 << W)) {
+			break;
+		}
+		CYCLES(cpu->prefix_cycles);
+		CX -= 1;
+		movs_element(cpu);
+		TRANSFERS(2);
+		CYCLES(18);
+		n++;
 	}
-	return I8086_DECODE_OK;
+	rep_bulk_end(cpu, n);
 }
-static int stos(I8086* cpu) {
-	/* stos (AA/AB) b1010101W */
+static int movs(I8086* cpu) {
+	/* movs (A4/A5) b1010010W */
 
 	/* Rep prefix check */
 	if (F1) {
@@ -2158,31 +2478,88 @@ static int stos(I8086* cpu) {
 	}
 
 	/* Do string operation */
-	if (W) {
-		write_word(cpu, ES, DI, AX);
-	}
-	else {
-		write_byte(cpu, ES, DI, AL);
-	}
-	TRANSFERS(1);
-	CYCLES(11);
+	uint16_t dest = DI;
+	movs_element(cpu);
+	TRANSFERS(2);
+	CYCLES(18);
 
-	/* Adjust si/di delta */
+	/* Rep prefix check */
+	if (F1) {
+		IP -= cpu->instruction_len; /* Allow interrupts */
+		if (!rep_bulk_writes_code(cpu, SEG_BASE(SEG_ES), dest, 1 << W)) {
+			movs_bulk(cpu);
+		}
+	}
+	return I8086_DECODE_OK;
+}
+
+static void stos_element(I8086* cpu) {
+	if (W) {
+		write_word(cpu, SEG_BASE(SEG_ES), DI, AX);
+	}
+	else {
+		write_byte(cpu, SEG_BASE(SEG_ES), DI, AL);
+	}
+
+	/* Adjust si/di delta */
 	if (DF) {
 		DI -= (1 << W);
 	}
 	else {
 		DI += (1 << W);
 	}
-
-	/* Rep prefix check */
-	if (F1) {
-		IP -= cpu->instruction_len; /* Allow interrupts */
+}
+static void stos_bulk(I8086* cpu) {
+#ifdef I8086_ENABLE_MEMORY_MAP
+	uint32_t cycles = cpu->prefix_cycles + 11 + (1 * 4);
+#endif
+	uint32_t n = 0;
+
+	while (rep_bulk_continue(cpu)) {
+#ifdef I8086_ENABLE_MEMORY_MAP
+		if (!DF) {
+			uint20_t dest_addr = I8086_BASE_ADDRESS(SEG_BASE(SEG_ES), DI);
+			uint8_t* dest = cpu->write_pages[dest_addr >> I8086_PAGE_SHIFT];
+			uint32_t count = rep_bulk_count(cpu, cycles, SEG_BASE(SEG_ES), DI);
+			uint32_t size = count << W;
+			if (dest != NULL && count != 0 && !rep_bulk_writes_code(cpu, SEG_BASE(SEG_ES), DI, size)) {
+				dest += dest_addr & I8086_PAGE_MASK;
+				if (W) {
+					for (uint32_t i = 0; i < size; i += 2) {
+						dest[i] = AL;
+						dest[i + 1] = AH;
+					}
+				}
+				else {
+					memset(dest, AL, size);
+				}
+#ifdef I8086_ENABLE_DECODE_CACHE
+				if (cpu->cache != NULL) {
+					i8086_cache_invalidate(cpu->cache, dest_addr, size);
+				}
+#endif
+				CX -= count;
+				DI += size;
+				cpu->cycles += (uint64_t)count * cycles;
+				n += count;
+				continue;
+			}
+		}
+#endif
+		if (rep_bulk_writes_code(cpu, SEG_BASE(SEG_ES), DI, 1 << W)) {
+			break;
+		}
+		CYCLES(cpu->prefix_cycles);
+		CX -= 1;
+		stos_element(cpu);
+		TRANSFERS(1);
+		CYCLES(11);
+		n++;
 	}
-	return I8086_DECODE_OK;
+	rep_bulk_end(cpu, n);
 }
-static int lods(I8086* cpu) {
-	/* lods (AC/AD) b1010110W */
+static int stos(I8086* cpu) {
+	/* stos (AA/AB) b1010101W */
 
 	/* Rep prefix check */
 	if (F1) {
@@ -2190,18 +2567,31 @@ static int lods(I8086* cpu) {
 			return I8086_DECODE_OK;
 		}
 		CX -= 1;
-		CYCLES(1); // +1 per REP
 	}
 
 	/* Do string operation */
+	uint16_t dest = DI;
+	stos_element(cpu);
+	TRANSFERS(1);
+	CYCLES(11);
+
+	/* Rep prefix check */
+	if (F1) {
+		IP -= cpu->instruction_len; /* Allow interrupts */
+		if (!rep_bulk_writes_code(cpu, SEG_BASE(SEG_ES), dest, 1 << W)) {
+			stos_bulk(cpu);
+		}
+	}
+	return I8086_DECODE_OK;
+}
+
+static void lods_element(I8086* cpu) {
 	if (W) {
-		AX = read_word(cpu, SEG_DEFAULT_OR_OVERRIDE(SEG_DS), SI);
+		AX = read_word(cpu, SEG_BASE_DEFAULT_OR_OVERRIDE(SEG_DS), SI);
 	}
 	else {
-		AL = read_byte(cpu, SEG_DEFAULT_OR_OVERRIDE(SEG_DS), SI);
+		AL = read_byte(cpu, SEG_BASE_DEFAULT_OR_OVERRIDE(SEG_DS), SI);
 	}
-	TRANSFERS(1);
-	CYCLES(12);
 
 	/* Adjust si/di delta */
 	if (DF) {
@@ -2210,15 +2600,50 @@ static int lods(I8086* cpu) {
 	else {
 		SI += (1 << W);
 	}
-
-	/* Rep prefix check */
-	if (F1) {
-		IP -= cpu->instruction_len; /* Allow interrupts */
+}
+static void lods_bulk(I8086* cpu) {
+#ifdef I8086_ENABLE_MEMORY_MAP
+	uint32_t cycles = cpu->prefix_cycles + 1 + 12 + (1 * 4);
+#endif
+	uint32_t n = 0;
+
+	while (rep_bulk_continue(cpu)) {
+#ifdef I8086_ENABLE_MEMORY_MAP
+		if (!DF) {
+			uint20_t base = SEG_BASE_DEFAULT_OR_OVERRIDE(SEG_DS);
+			uint20_t src_addr = I8086_BASE_ADDRESS(base, SI);
+			uint8_t* src = cpu->read_pages[src_addr >> I8086_PAGE_SHIFT];
+			uint32_t count = rep_bulk_count(cpu, cycles, base, SI);
+			uint32_t size = count << W;
+			if (src != NULL && count != 0) {
+				/* only the last element is kept */
+				src += (src_addr & I8086_PAGE_MASK) + size - (1 << W);
+				if (W) {
+					AX = ((uint16_t)src[1] << 8) | src[0];
+				}
+				else {
+					AL = src[0];
+				}
+				CX -= count;
+				SI += size;
+				cpu->cycles += (uint64_t)count * cycles;
+				n += count;
+				continue;
+			}
+		}
+#endif
+		CYCLES(cpu->prefix_cycles);
+		CX -= 1;
+		CYCLES(1); // +1 per REP
+		lods_element(cpu);
+		TRANSFERS(1);
+		CYCLES(12);
+		n++;
 	}
-	return I8086_DECODE_OK;
+	rep_bulk_end(cpu, n);
 }
-static int cmps(I8086* cpu) {
-	/* cmps (A6/A7) b1010011W */
+static int lods(I8086* cpu) {
+	/* lods (AC/AD) b1010110W */
 
 	/* Rep prefix check */
 	if (F1) {
@@ -2226,21 +2651,69 @@ static int cmps(I8086* cpu) {
 			return I8086_DECODE_OK;
 		}
 		CX -= 1;
+		CYCLES(1); // +1 per REP
 	}
 
 	/* Do string operation */
+	lods_element(cpu);
+	TRANSFERS(1);
+	CYCLES(12);
+
+	/* Rep prefix check */
+	if (F1) {
+		IP -= cpu->instruction_len; /* Allow interrupts */
+		lods_bulk(cpu);
+	}
+	return I8086_DECODE_OK;
+}
+#ifdef I8086_ENABLE_MEMORY_MAP
+/* Index of the first element where (a[i] == b[i]) == equal, or count if none.
+   b is NULL for scas; the elements are compared against value.
+   16 bytes are compared at a time with SSE2 when available */
+static uint32_t rep_scan(const uint8_t* a, const uint8_t* b, uint16_t value, uint32_t count, int word, int equal) {
+	uint32_t size = count << word;
+	uint32_t i = 0;
+#ifdef I8086_SSE2
+	__m128i v = word ? _mm_set1_epi16((short)value) : _mm_set1_epi8((char)value);
+	for (; i + 16 <= size; i += 16) {
+		__m128i x = _mm_loadu_si128((const __m128i*)(a + i));
+		__m128i y = (b != NULL) ? _mm_loadu_si128((const __m128i*)(b + i)) : v;
+		__m128i eq = word ? _mm_cmpeq_epi16(x, y) : _mm_cmpeq_epi8(x, y);
+		uint32_t mask = (uint32_t)_mm_movemask_epi8(eq);
+		if (!equal) {
+			mask = ~mask & 0xFFFF;
+		}
+		if (mask != 0) {
+			return (i + CTZ32(mask)) >> word;
+		}
+	}
+#endif
+	for (i >>= word; i < count; ++i) {
+		uint16_t x = a[i << word];
+		uint16_t y = (b != NULL) ? b[i << word] : (value & 0xFF);
+		if (word) {
+			x |= a[(i << 1) + 1] << 8;
+			y = (b != NULL) ? (y | (b[(i << 1) + 1] << 8)) : value;
+		}
+		if ((x == y) == equal) {
+			return i;
+		}
+	}
+	return count;
+}
+#endif
+
+static void cmps_element(I8086* cpu) {
 	if (W) {
-		uint16_t src = read_word(cpu, SEG_DEFAULT_OR_OVERRIDE(SEG_DS), SI);
-		uint16_t dest = read_word(cpu, ES, DI);
+		uint16_t src = read_word(cpu, SEG_BASE_DEFAULT_OR_OVERRIDE(SEG_DS), SI);
+		uint16_t dest = read_word(cpu, SEG_BASE(SEG_ES), DI);
 		alu_cmp16(cpu, src, dest);
 	}
 	else {
-		uint8_t src = read_byte(cpu, SEG_DEFAULT_OR_OVERRIDE(SEG_DS), SI);
-		uint8_t dest = read_byte(cpu, ES, DI);
+		uint8_t src = read_byte(cpu, SEG_BASE_DEFAULT_OR_OVERRIDE(SEG_DS), SI);
+		uint8_t dest = read_byte(cpu, SEG_BASE(SEG_ES), DI);
 		alu_cmp8(cpu, src, dest);
 	}
-	TRANSFERS(2);
-	CYCLES(22);
 
 	/* Adjust si/di delta */
 	if (DF) {
@@ -2251,15 +2724,76 @@ static int cmps(I8086* cpu) {
 		SI += (1 << W);
 		DI += (1 << W);
 	}
+}
+static void cmps_bulk(I8086* cpu) {
+#ifdef I8086_ENABLE_MEMORY_MAP
+	uint32_t cycles = cpu->prefix_cycles + 22 + (2 * 4);
+#endif
+	uint32_t n = 0;
+
+	while (rep_bulk_continue(cpu)) {
+#ifdef I8086_ENABLE_MEMORY_MAP
+		if (!DF) {
+			uint20_t base = SEG_BASE_DEFAULT_OR_OVERRIDE(SEG_DS);
+			uint20_t src_addr = I8086_BASE_ADDRESS(base, SI);
+			uint20_t dest_addr = I8086_BASE_ADDRESS(SEG_BASE(SEG_ES), DI);
+			uint8_t* src = cpu->read_pages[src_addr >> I8086_PAGE_SHIFT];
+			uint8_t* dest = cpu->read_pages[dest_addr >> I8086_PAGE_SHIFT];
+			uint32_t count = rep_bulk_count(cpu, cycles, base, SI);
+			uint32_t dest_count = rep_bulk_count(cpu, cycles, SEG_BASE(SEG_ES), DI);
+			if (dest_count < count) {
+				count = dest_count;
+			}
+			if (src != NULL && dest != NULL && count != 0) {
+				src += src_addr & I8086_PAGE_MASK;
+				dest += dest_addr & I8086_PAGE_MASK;
+
+				/* repz stops on the first difference; repnz on the first match */
+				uint32_t i = rep_scan(src, dest, 0, count, W, !F1Z);
+				int done = (i < count);
+				if (!done) {
+					i = count - 1;
+				}
+
+				/* flags of the last element compared */
+				if (W) {
+					alu_cmp16(cpu, ((uint16_t)src[(i << 1) + 1] << 8) | src[i << 1], ((uint16_t)dest[(i << 1) + 1] << 8) | dest[i << 1]);
+				}
+				else {
+					alu_cmp8(cpu, src[i], dest[i]);
+				}
+				SYNC_FLAGS();
+
+				CX -= i + 1;
+				SI += (i + 1) << W;
+				DI += (i + 1) << W;
+				cpu->cycles += (uint64_t)(i + 1) * cycles;
+				n += i + 1;
+				if (done) {
+					IP += cpu->instruction_len;
+					break;
+				}
+				continue;
+			}
+		}
+#endif
+		CYCLES(cpu->prefix_cycles);
+		CX -= 1;
+		cmps_element(cpu);
+		TRANSFERS(2);
+		CYCLES(22);
+		n++;
 
-	/* Rep prefix check */
-	if (F1 && ZF == F1Z) {
-		IP -= cpu->instruction_len; /* Allow interrupts */
+		SYNC_FLAGS();
+		if (ZF != F1Z) {
+			IP += cpu->instruction_len;
+			break;
+		}
 	}
-	return I8086_DECODE_OK;
+	rep_bulk_end(cpu, n);
 }
-static int scas(I8086* cpu) {
-	/* scas (AE/AF) b1010111W */
+static int cmps(I8086* cpu) {
+	/* cmps (A6/A7) b1010011W */
 
 	/* Rep prefix check */
 	if (F1) {
@@ -2270,16 +2804,28 @@ static int scas(I8086* cpu) {
 	}
 
 	/* Do string operation */
+	cmps_element(cpu);
+	TRANSFERS(2);
+	CYCLES(22);
+
+	/* Rep prefix check */
+	SYNC_FLAGS();
+	if (F1 && ZF == F1Z) {
+		IP -= cpu->instruction_len; /* Allow interrupts */
+		cmps_bulk(cpu);
+	}
+	return I8086_DECODE_OK;
+}
+
+static void scas_element(I8086* cpu) {
 	if (W) {
-		uint16_t dest = read_word(cpu, ES, DI);
+		uint16_t dest = read_word(cpu, SEG_BASE(SEG_ES), DI);
 		alu_cmp16(cpu, AX, dest);
 	}
 	else {
-		uint8_t dest = read_byte(cpu, ES, DI);
+		uint8_t dest = read_byte(cpu, SEG_BASE(SEG_ES), DI);
 		alu_cmp8(cpu, AL, dest);
 	}
-	TRANSFERS(1);
-	CYCLES(15);
 
 	/* Adjust si/di delta */
 	if (DF) {
@@ -2288,10 +2834,86 @@ static int scas(I8086* cpu) {
 	else {
 		DI += (1 << W);
 	}
+}
+static void scas_bulk(I8086* cpu) {
+#ifdef I8086_ENABLE_MEMORY_MAP
+	uint32_t cycles = cpu->prefix_cycles + 15 + (1 * 4);
+#endif
+	uint32_t n = 0;
+
+	while (rep_bulk_continue(cpu)) {
+#ifdef I8086_ENABLE_MEMORY_MAP
+		if (!DF) {
+			uint20_t dest_addr = I8086_BASE_ADDRESS(SEG_BASE(SEG_ES), DI);
+			uint8_t* dest = cpu->read_pages[dest_addr >> I8086_PAGE_SHIFT];
+			uint32_t count = rep_bulk_count(cpu, cycles, SEG_BASE(SEG_ES), DI);
+			if (dest != NULL && count != 0) {
+				dest += dest_addr & I8086_PAGE_MASK;
+
+				/* repz stops on the first difference; repnz on the first match */
+				uint32_t i = rep_scan(dest, NULL, W ? AX : AL, count, W, !F1Z);
+				int done = (i < count);
+				if (!done) {
+					i = count - 1;
+				}
+
+				/* flags of the last element compared */
+				if (W) {
+					alu_cmp16(cpu, AX, ((uint16_t)dest[(i << 1) + 1] << 8) | dest[i << 1]);
+				}
+				else {
+					alu_cmp8(cpu, AL, dest[i]);
+				}
+				SYNC_FLAGS();
+
+				CX -= i + 1;
+				DI += (i + 1) << W;
+				cpu->cycles += (uint64_t)(i + 1) * cycles;
+				n += i + 1;
+				if (done) {
+					IP += cpu->instruction_len;
+					break;
+				}
+				continue;
+			}
+		}
+#endif
+		CYCLES(cpu->prefix_cycles);
+		CX -= 1;
+		scas_element(cpu);
+		TRANSFERS(1);
+		CYCLES(15);
+		n++;
+
+		SYNC_FLAGS();
+		if (ZF != F1Z) {
+			IP += cpu->instruction_len;
+			break;
+		}
+	}
+	rep_bulk_end(cpu, n);
+}
+static int scas(I8086* cpu) {
+	/* scas (AE/AF) b1010111W */
+
+	/* Rep prefix check */
+	if (F1) {
+		if (CX == 0) {
+			return I8086_DECODE_OK;
+		}
+		CX -= 1;
+	}
+
+	/* Do string operation */
+	scas_element(cpu);
+	TRANSFERS(1);
+	CYCLES(15);
 
 	/* Rep prefix check */
+	SYNC_FLAGS();
 	if (F1 && ZF == F1Z) {
 		IP -= cpu->instruction_len; /* Allow interrupts */
+		scas_bulk(cpu);
 	}
 	return I8086_DECODE_OK;
 }
@@ -2299,29 +2921,29 @@ static int scas(I8086* cpu) {
 static void les(I8086* cpu) {
 	/* les (C4) b11000100 */
 	fetch_modrm(cpu);
-	uint16_t segment = modrm_get_segment(cpu);
+	uint20_t base = modrm_get_segment_base(cpu);
 	uint16_t offset = modrm_get_offset(cpu);
-	uint16_t tmp = read_word(cpu, segment, offset);
+	uint16_t tmp = read_word(cpu, base, offset);
 	reg16_write(cpu, cpu->modrm.reg, tmp);
-	ES = read_word(cpu, segment, offset + 2);
+	seg_write(cpu, SEG_ES, read_word(cpu, base, offset + 2));
 	TRANSFERS(2);
 	CYCLES(16);
 }
 static void lds(I8086* cpu) {
 	/* lds (C5) b11000101 */
 	fetch_modrm(cpu);
-	uint16_t segment = modrm_get_segment(cpu);
+	uint20_t base = modrm_get_segment_base(cpu);
 	uint16_t offset = modrm_get_offset(cpu);
-	uint16_t tmp = read_word(cpu, segment, offset);
+	uint16_t tmp = read_word(cpu, base, offset);
 	reg16_write(cpu, cpu->modrm.reg, tmp);
-	DS = read_word(cpu, segment, offset + 2);
+	seg_write(cpu, SEG_DS, read_word(cpu, base, offset + 2));
 	TRANSFERS(2);
 	CYCLES(16);
 }
 
 static void xlat(I8086* cpu) {
 	/* Get data pointed by BX + AL (D7) b11010111 */
-	uint8_t mem = read_byte(cpu, SEG_DEFAULT_OR_OVERRIDE(SEG_DS), BX + AL);
+	uint8_t mem = read_byte(cpu, SEG_BASE_DEFAULT_OR_OVERRIDE(SEG_DS), BX + AL);
 	AL = mem;
 	TRANSFERS(1);
 	CYCLES(11);
@@ -2345,6 +2967,7 @@ static void loopnz(I8086* cpu) {
 	uint8_t imm = fetch_byte(cpu);
 	uint16_t se = sign_extend8_16(imm);
 	CX -= 1;
+	SYNC_FLAGS();
 	if (CX && !ZF) {
 		IP += se;
 		CYCLES(19);
@@ -2358,6 +2981,7 @@ static void loopz(I8086* cpu) {
 	uint8_t imm = fetch_byte(cpu);
 	uint16_t se = sign_extend8_16(imm);
 	CX -= 1;
+	SYNC_FLAGS();
 	if (CX && ZF) {
 		IP += se;
 		CYCLES(18);
@@ -2384,10 +3008,10 @@ static void in_accum_imm(I8086* cpu) {
 	/* in AL/AX, imm */
 	uint8_t imm = fetch_byte(cpu);
 	if (W) {
-		AX = (READ_IO_BYTE(imm) | (READ_IO_BYTE(imm + 1) << 8));
+		AX = read_io_word(cpu, imm);
 	}
 	else {
-		AL = READ_IO_BYTE(imm);
+		AL = read_io_byte(cpu, imm);
 	}
 	TRANSFERS(1);
 	CYCLES(10);
@@ -2396,11 +3020,10 @@ static void out_accum_imm(I8086* cpu) {
 	/* out imm, AL/AX */
 	uint8_t imm = fetch_byte(cpu);
 	if (W) {
-		WRITE_IO_BYTE(imm, AL);
-		WRITE_IO_BYTE(imm + 1, AH);
+		write_io_word(cpu, imm, AX);
 	}
 	else {
-		WRITE_IO_BYTE(imm, AL);
+		write_io_byte(cpu, imm, AL);
 	}
 	TRANSFERS(1);
 	CYCLES(10);
@@ -2408,10 +3031,10 @@ static void out_accum_imm(I8086* cpu) {
 static void in_accum_dx(I8086* cpu) {
 	/* in AL/AX, DX */
 	if (W) {
-		AX = (READ_IO_BYTE(DX) | (READ_IO_BYTE(DX + 1) << 8));
+		AX = read_io_word(cpu, DX);
 	}
 	else {
-		AL = READ_IO_BYTE(DX);
+		AL = read_io_byte(cpu, DX);
 	}
 	TRANSFERS(1);
 	CYCLES(8);
@@ -2419,11 +3042,10 @@ static void in_accum_dx(I8086* cpu) {
 static void out_accum_dx(I8086* cpu) {
 	/* out DX, AL/AX */
 	if (W) {
-		WRITE_IO_BYTE(DX, AL);
-		WRITE_IO_BYTE(DX + 1, AH);
+		write_io_word(cpu, DX, AX);
 	}
 	else {
-		WRITE_IO_BYTE(DX, AL);
+		write_io_byte(cpu, DX, AL);
 	}
 	TRANSFERS(1);
 	CYCLES(8);
@@ -2444,6 +3066,7 @@ static void int3(I8086* cpu) {
 }
 static void into(I8086* cpu) {
 	/* interrupt on overflow (CE) b11001110 */
+	SYNC_FLAGS();
 	if (OF) {
 		i8086_int(cpu, INT_OVERFLOW);
 		TRANSFERS(5);
@@ -2456,10 +3079,12 @@ static void into(I8086* cpu) {
 static void iret(I8086* cpu) {
 	/* return from interrupt (CF) b11001111 */
 	pop_word(cpu, &IP);
-	pop_word(cpu, &CS);
+	pop_seg_word(cpu, SEG_CS);
 	uint16_t psw = 0;
 	pop_word(cpu, &psw);
 	PSW = (psw | 0xF002) & 0xFFD7;
+	DISCARD_FLAGS();
+	cpu->pending |= I8086_PENDING_LATCH; // IF/TF may have changed
 	TRANSFERS(3);
 	CYCLES(24);
 }
@@ -2472,20 +3097,20 @@ static int rep(I8086* cpu) {
 	cpu->internal_flags |= (cpu->opcode & 0x1); /* Set F1Z */
 	
 	cpu->opcode = fetch_byte(cpu);
-	CYCLES(9);
+	PREFIX_CYCLES(9);
 	return I8086_DECODE_REQ_CYCLE;
 }
 static int segment_override(I8086* cpu) {
 	/* (26/2E/36/3E) b001SR110 */
 	cpu->segment_prefix = SR;
 	cpu->opcode = fetch_byte(cpu);
-	CYCLES(2);
+	PREFIX_CYCLES(2);
 	return I8086_DECODE_REQ_CYCLE;
 }
 static int lock(I8086* cpu) {
 	/* lock the bus (F0/F1) b11110000 */
 	cpu->opcode = fetch_byte(cpu);
-	CYCLES(2);
+	PREFIX_CYCLES(2);
 	return I8086_DECODE_REQ_CYCLE;
 }
 
@@ -2495,10 +3120,12 @@ static void i8086_fetch(I8086* cpu) {
 	cpu->modrm.byte = 0;
 	cpu->segment_prefix = 0xFF;
 	cpu->instruction_len = 0;
+	cpu->prefix_cycles = 0;
 	cpu->opcode = fetch_byte(cpu);
 }
 
 /* decode opcode */
+#ifdef I8086_DISPATCH_SWITCH
 static void i8086_decode_opcode_80(I8086* cpu) {
 	/* 0x80 - 0x83 b100000SW (Immed) */
 	fetch_modrm(cpu);
@@ -2622,10 +3249,16 @@ static int i8086_decode_opcode_fe(I8086* cpu) {
 static int i8086_decode_opcode(I8086* cpu) {
 	switch (cpu->opcode) {
 		case 0x00:
+			add_rm_reg8(cpu);
+			break;
 		case 0x01:
+			add_rm_reg16(cpu);
+			break;
 		case 0x02:
+			add_reg_rm8(cpu);
+			break;
 		case 0x03:
-			add_rm_reg(cpu);
+			add_reg_rm16(cpu);
 			break;
 		case 0x04:
 		case 0x05:
@@ -2638,10 +3271,16 @@ static int i8086_decode_opcode(I8086* cpu) {
 			pop_seg(cpu);
 			break;
 		case 0x08:
+			or_rm_reg8(cpu);
+			break;
 		case 0x09:
+			or_rm_reg16(cpu);
+			break;
 		case 0x0A:
+			or_reg_rm8(cpu);
+			break;
 		case 0x0B:
-			or_rm_reg(cpu);
+			or_reg_rm16(cpu);
 			break;
 		case 0x0C:
 		case 0x0D:
@@ -2655,10 +3294,16 @@ static int i8086_decode_opcode(I8086* cpu) {
 			break;
 		
 		case 0x10:
+			adc_rm_reg8(cpu);
+			break;
 		case 0x11:
+			adc_rm_reg16(cpu);
+			break;
 		case 0x12:
+			adc_reg_rm8(cpu);
+			break;
 		case 0x13:
-			adc_rm_reg(cpu);
+			adc_reg_rm16(cpu);
 			break;
 		case 0x14:
 		case 0x15:
@@ -2671,10 +3316,16 @@ static int i8086_decode_opcode(I8086* cpu) {
 			pop_seg(cpu);
 			break;
 		case 0x18:
+			sbb_rm_reg8(cpu);
+			break;
 		case 0x19:
+			sbb_rm_reg16(cpu);
+			break;
 		case 0x1A:
+			sbb_reg_rm8(cpu);
+			break;
 		case 0x1B:
-			sbb_rm_reg(cpu);
+			sbb_reg_rm16(cpu);
 			break;
 		case 0x1C:
 		case 0x1D:
@@ -2688,10 +3339,16 @@ static int i8086_decode_opcode(I8086* cpu) {
 			break;
 		
 		case 0x20:
+			and_rm_reg8(cpu);
+			break;
 		case 0x21:
+			and_rm_reg16(cpu);
+			break;
 		case 0x22:
+			and_reg_rm8(cpu);
+			break;
 		case 0x23:
-			and_rm_reg(cpu);
+			and_reg_rm16(cpu);
 			break;
 		case 0x24:
 		case 0x25:
@@ -2703,10 +3360,16 @@ static int i8086_decode_opcode(I8086* cpu) {
 			daa(cpu);
 			break;
 		case 0x28:
+			sub_rm_reg8(cpu);
+			break;
 		case 0x29:
+			sub_rm_reg16(cpu);
+			break;
 		case 0x2A:
+			sub_reg_rm8(cpu);
+			break;
 		case 0x2B:
-			sub_rm_reg(cpu);
+			sub_reg_rm16(cpu);
 			break;
 		case 0x2C:
 		case 0x2D:
@@ -2719,10 +3382,16 @@ static int i8086_decode_opcode(I8086* cpu) {
 			break;
 		
 		case 0x30:
+			xor_rm_reg8(cpu);
+			break;
 		case 0x31:
+			xor_rm_reg16(cpu);
+			break;
 		case 0x32:
+			xor_reg_rm8(cpu);
+			break;
 		case 0x33:
-			xor_rm_reg(cpu);
+			xor_reg_rm16(cpu);
 			break;
 		case 0x34:
 		case 0x35:
@@ -2734,10 +3403,16 @@ static int i8086_decode_opcode(I8086* cpu) {
 			aaa(cpu);
 			break;
 		case 0x38:
+			cmp_rm_reg8(cpu);
+			break;
 		case 0x39:
+			cmp_rm_reg16(cpu);
+			break;
 		case 0x3A:
+			cmp_reg_rm8(cpu);
+			break;
 		case 0x3B:
-			cmp_rm_reg(cpu);
+			cmp_reg_rm16(cpu);
 			break;
 		case 0x3C:
 		case 0x3D:
@@ -2839,8 +3514,10 @@ static int i8086_decode_opcode(I8086* cpu) {
 			i8086_decode_opcode_80(cpu);
 			break;
 		case 0x84:
+			test_rm_reg8(cpu);
+			break;
 		case 0x85:
-			test_rm_reg(cpu);
+			test_rm_reg16(cpu);
 			break;
 		case 0x86:
 		case 0x87:
@@ -3104,12 +3781,414 @@ static int i8086_decode_instruction(I8086* cpu) {
 	} while (r == I8086_DECODE_REQ_CYCLE);
 	return r;
 }
+#else
+static void (*const opcode_80_table[8])(I8086*) = {
+	add_rm_imm, or_rm_imm, adc_rm_imm, sbb_rm_imm, and_rm_imm, sub_rm_imm, xor_rm_imm, cmp_rm_imm
+};
+static void (*const opcode_d0_table[8])(I8086*) = {
+	/* b110; 8086 undocumented; Set Minus One (-1) */
+	rol, ror, rcl, rcr, shl, shr, setmo, sar
+};
+static void (*const opcode_f6_table[8])(I8086*) = {
+	/* b001; 8086 undocumented; Decodes identically to b000 */
+	test_rm_imm, test_rm_imm, not, neg, mul_rm, imul_rm, div_rm, idiv_rm
+};
+
+/* Wrap an opcode routine as a table handler; int (*)(I8086*) returning I8086_DECODE_* */
+#define OPCODE_VOID(name) static int op_##name(I8086* cpu) { name(cpu); return I8086_DECODE_OK; }
+#define OPCODE_INT(name)  static int op_##name(I8086* cpu) { return name(cpu); }
+
+OPCODE_VOID(inc_rm)
+OPCODE_VOID(dec_rm)
+OPCODE_VOID(call_intra_indirect)
+OPCODE_INT(call_inter_indirect)
+OPCODE_VOID(jmp_intra_indirect)
+OPCODE_INT(jmp_inter_indirect)
+OPCODE_VOID(push_rm)
+
+static int (*const opcode_fe_table[8])(I8086*) = {
+	/* b111; 8086 undocumented; Decodes identically to b110 */
+	op_inc_rm, op_dec_rm, op_call_intra_indirect, op_call_inter_indirect, op_jmp_intra_indirect, op_jmp_inter_indirect, op_push_rm, op_push_rm
+};
+
+static int op_decode_80(I8086* cpu) {
+	/* 0x80 - 0x83 b100000SW (Immed) */
+	fetch_modrm(cpu);
+	opcode_80_table[cpu->modrm.reg](cpu);
+	return I8086_DECODE_OK;
+}
+static int op_decode_d0(I8086* cpu) {
+	/* 0xD0 - 0xD3 b110100VW (Shift) */
+	fetch_modrm(cpu);
+	opcode_d0_table[cpu->modrm.reg](cpu);
+	return I8086_DECODE_OK;
+}
+static int op_decode_f6(I8086* cpu) {
+	/* F6/F7 b1111011W (Group 1) */
+	fetch_modrm(cpu);
+	opcode_f6_table[cpu->modrm.reg](cpu);
+	return I8086_DECODE_OK;
+}
+static int op_decode_fe(I8086* cpu) {
+	/* FE/FF b1111111W (Group 2) */
+	fetch_modrm(cpu);
+	return opcode_fe_table[cpu->modrm.reg](cpu);
+}
+
+OPCODE_VOID(add_rm_reg8)
+OPCODE_VOID(add_rm_reg16)
+OPCODE_VOID(add_reg_rm8)
+OPCODE_VOID(add_reg_rm16)
+OPCODE_VOID(add_accum_imm)
+OPCODE_VOID(or_rm_reg8)
+OPCODE_VOID(or_rm_reg16)
+OPCODE_VOID(or_reg_rm8)
+OPCODE_VOID(or_reg_rm16)
+OPCODE_VOID(or_accum_imm)
+OPCODE_VOID(adc_rm_reg8)
+OPCODE_VOID(adc_rm_reg16)
+OPCODE_VOID(adc_reg_rm8)
+OPCODE_VOID(adc_reg_rm16)
+OPCODE_VOID(adc_accum_imm)
+OPCODE_VOID(sbb_rm_reg8)
+OPCODE_VOID(sbb_rm_reg16)
+OPCODE_VOID(sbb_reg_rm8)
+OPCODE_VOID(sbb_reg_rm16)
+OPCODE_VOID(sbb_accum_imm)
+OPCODE_VOID(and_rm_reg8)
+OPCODE_VOID(and_rm_reg16)
+OPCODE_VOID(and_reg_rm8)
+OPCODE_VOID(and_reg_rm16)
+OPCODE_VOID(and_accum_imm)
+OPCODE_VOID(sub_rm_reg8)
+OPCODE_VOID(sub_rm_reg16)
+OPCODE_VOID(sub_reg_rm8)
+OPCODE_VOID(sub_reg_rm16)
+OPCODE_VOID(sub_accum_imm)
+OPCODE_VOID(xor_rm_reg8)
+OPCODE_VOID(xor_rm_reg16)
+OPCODE_VOID(xor_reg_rm8)
+OPCODE_VOID(xor_reg_rm16)
+OPCODE_VOID(xor_accum_imm)
+OPCODE_VOID(cmp_rm_reg8)
+OPCODE_VOID(cmp_rm_reg16)
+OPCODE_VOID(cmp_reg_rm8)
+OPCODE_VOID(cmp_reg_rm16)
+OPCODE_VOID(cmp_accum_imm)
+OPCODE_VOID(test_rm_reg8)
+OPCODE_VOID(test_rm_reg16)
+OPCODE_VOID(test_accum_imm)
+OPCODE_VOID(daa)
+OPCODE_VOID(das)
+OPCODE_VOID(aaa)
+OPCODE_VOID(aas)
+OPCODE_VOID(aam)
+OPCODE_VOID(aad)
+OPCODE_VOID(salc)
+OPCODE_VOID(push_seg)
+OPCODE_VOID(pop_seg)
+OPCODE_VOID(push_reg)
+OPCODE_VOID(pop_reg)
+OPCODE_VOID(pop_rm)
+OPCODE_VOID(pushf)
+OPCODE_VOID(popf)
+OPCODE_VOID(nop)
+OPCODE_VOID(xchg_accum_reg)
+OPCODE_VOID(xchg_rm_reg)
+OPCODE_VOID(cbw)
+OPCODE_VOID(cwd)
+OPCODE_VOID(wait)
+OPCODE_VOID(sahf)
+OPCODE_VOID(lahf)
+OPCODE_VOID(hlt)
+OPCODE_VOID(cmc)
+OPCODE_VOID(clc)
+OPCODE_VOID(stc)
+OPCODE_VOID(cli)
+OPCODE_VOID(sti)
+OPCODE_VOID(cld)
+OPCODE_VOID(std)
+OPCODE_VOID(inc_reg)
+OPCODE_VOID(dec_reg)
+OPCODE_VOID(jcc)
+OPCODE_VOID(jcxz)
+OPCODE_VOID(jmp_intra_direct_short)
+OPCODE_VOID(jmp_intra_direct)
+OPCODE_VOID(jmp_inter_direct)
+OPCODE_VOID(call_intra_direct)
+OPCODE_VOID(call_inter_direct)
+OPCODE_VOID(ret_intra_add_imm)
+OPCODE_VOID(ret_intra)
+OPCODE_VOID(ret_inter_add_imm)
+OPCODE_VOID(ret_inter)
+OPCODE_VOID(mov_rm_imm)
+OPCODE_VOID(mov_reg_imm)
+OPCODE_VOID(mov_rm_reg)
+OPCODE_VOID(mov_accum_mem)
+OPCODE_VOID(mov_seg)
+OPCODE_VOID(lea)
+OPCODE_INT(movs)
+OPCODE_INT(stos)
+OPCODE_INT(lods)
+OPCODE_INT(cmps)
+OPCODE_INT(scas)
+OPCODE_VOID(les)
+OPCODE_VOID(lds)
+OPCODE_VOID(xlat)
+OPCODE_VOID(esc)
+OPCODE_VOID(loopnz)
+OPCODE_VOID(loopz)
+OPCODE_VOID(loop)
+OPCODE_VOID(in_accum_imm)
+OPCODE_VOID(out_accum_imm)
+OPCODE_VOID(in_accum_dx)
+OPCODE_VOID(out_accum_dx)
+OPCODE_VOID(int_)
+OPCODE_VOID(int3)
+OPCODE_VOID(into)
+OPCODE_VOID(iret)
+OPCODE_INT(rep)
+OPCODE_INT(segment_override)
+OPCODE_INT(lock)
+
+/* Opcode map; X(opcode, handler). The handler is called as op_<handler>
+	8086 undocumented; 0x60-0x6F decodes identically to 0x70-0x7F
+	8086 undocumented; 0xC0, 0xC1, 0xC8, 0xC9 decode identically to 0xC2, 0xC3, 0xCA, 0xCB
+	8086 undocumented; 0xF1 decodes identically to 0xF0 */
+#define I8086_OPCODES(X) \
+	X(0x00, add_rm_reg8) X(0x01, add_rm_reg16) X(0x02, add_reg_rm8) X(0x03, add_reg_rm16) \
+	X(0x04, add_accum_imm) X(0x05, add_accum_imm) X(0x06, push_seg) X(0x07, pop_seg) \
+	X(0x08, or_rm_reg8) X(0x09, or_rm_reg16) X(0x0A, or_reg_rm8) X(0x0B, or_reg_rm16) \
+	X(0x0C, or_accum_imm) X(0x0D, or_accum_imm) X(0x0E, push_seg) X(0x0F, pop_seg) \
+	X(0x10, adc_rm_reg8) X(0x11, adc_rm_reg16) X(0x12, adc_reg_rm8) X(0x13, adc_reg_rm16) \
+	X(0x14, adc_accum_imm) X(0x15, adc_accum_imm) X(0x16, push_seg) X(0x17, pop_seg) \
+	X(0x18, sbb_rm_reg8) X(0x19, sbb_rm_reg16) X(0x1A, sbb_reg_rm8) X(0x1B, sbb_reg_rm16) \
+	X(0x1C, sbb_accum_imm) X(0x1D, sbb_accum_imm) X(0x1E, push_seg) X(0x1F, pop_seg) \
+	X(0x20, and_rm_reg8) X(0x21, and_rm_reg16) X(0x22, and_reg_rm8) X(0x23, and_reg_rm16) \
+	X(0x24, and_accum_imm) X(0x25, and_accum_imm) X(0x26, segment_override) X(0x27, daa) \
+	X(0x28, sub_rm_reg8) X(0x29, sub_rm_reg16) X(0x2A, sub_reg_rm8) X(0x2B, sub_reg_rm16) \
+	X(0x2C, sub_accum_imm) X(0x2D, sub_accum_imm) X(0x2E, segment_override) X(0x2F, das) \
+	X(0x30, xor_rm_reg8) X(0x31, xor_rm_reg16) X(0x32, xor_reg_rm8) X(0x33, xor_reg_rm16) \
+	X(0x34, xor_accum_imm) X(0x35, xor_accum_imm) X(0x36, segment_override) X(0x37, aaa) \
+	X(0x38, cmp_rm_reg8) X(0x39, cmp_rm_reg16) X(0x3A, cmp_reg_rm8) X(0x3B, cmp_reg_rm16) \
+	X(0x3C, cmp_accum_imm) X(0x3D, cmp_accum_imm) X(0x3E, segment_override) X(0x3F, aas) \
+	X(0x40, inc_reg) X(0x41, inc_reg) X(0x42, inc_reg) X(0x43, inc_reg) \
+	X(0x44, inc_reg) X(0x45, inc_reg) X(0x46, inc_reg) X(0x47, inc_reg) \
+	X(0x48, dec_reg) X(0x49, dec_reg) X(0x4A, dec_reg) X(0x4B, dec_reg) \
+	X(0x4C, dec_reg) X(0x4D, dec_reg) X(0x4E, dec_reg) X(0x4F, dec_reg) \
+	X(0x50, push_reg) X(0x51, push_reg) X(0x52, push_reg) X(0x53, push_reg) \
+	X(0x54, push_reg) X(0x55, push_reg) X(0x56, push_reg) X(0x57, push_reg) \
+	X(0x58, pop_reg) X(0x59, pop_reg) X(0x5A, pop_reg) X(0x5B, pop_reg) \
+	X(0x5C, pop_reg) X(0x5D, pop_reg) X(0x5E, pop_reg) X(0x5F, pop_reg) \
+	X(0x60, jcc) X(0x61, jcc) X(0x62, jcc) X(0x63, jcc) \
+	X(0x64, jcc) X(0x65, jcc) X(0x66, jcc) X(0x67, jcc) \
+	X(0x68, jcc) X(0x69, jcc) X(0x6A, jcc) X(0x6B, jcc) \
+	X(0x6C, jcc) X(0x6D, jcc) X(0x6E, jcc) X(0x6F, jcc) \
+	X(0x70, jcc) X(0x71, jcc) X(0x72, jcc) X(0x73, jcc) \
+	X(0x74, jcc) X(0x75, jcc) X(0x76, jcc) X(0x77, jcc) \
+	X(0x78, jcc) X(0x79, jcc) X(0x7A, jcc) X(0x7B, jcc) \
+	X(0x7C, jcc) X(0x7D, jcc) X(0x7E, jcc) X(0x7F, jcc) \
+	X(0x80, decode_80) X(0x81, decode_80) X(0x82, decode_80) X(0x83, decode_80) \
+	X(0x84, test_rm_reg8) X(0x85, test_rm_reg16) X(0x86, xchg_rm_reg) X(0x87, xchg_rm_reg) \
+	X(0x88, mov_rm_reg) X(0x89, mov_rm_reg) X(0x8A, mov_rm_reg) X(0x8B, mov_rm_reg) \
+	X(0x8C, mov_seg) X(0x8D, lea) X(0x8E, mov_seg) X(0x8F, pop_rm) \
+	X(0x90, nop) X(0x91, xchg_accum_reg) X(0x92, xchg_accum_reg) X(0x93, xchg_accum_reg) \
+	X(0x94, xchg_accum_reg) X(0x95, xchg_accum_reg) X(0x96, xchg_accum_reg) X(0x97, xchg_accum_reg) \
+	X(0x98, cbw) X(0x99, cwd) X(0x9A, call_inter_direct) X(0x9B, wait) \
+	X(0x9C, pushf) X(0x9D, popf) X(0x9E, sahf) X(0x9F, lahf) \
+	X(0xA0, mov_accum_mem) X(0xA1, mov_accum_mem) X(0xA2, mov_accum_mem) X(0xA3, mov_accum_mem) \
+	X(0xA4, movs) X(0xA5, movs) X(0xA6, cmps) X(0xA7, cmps) \
+	X(0xA8, test_accum_imm) X(0xA9, test_accum_imm) X(0xAA, stos) X(0xAB, stos) \
+	X(0xAC, lods) X(0xAD, lods) X(0xAE, scas) X(0xAF, scas) \
+	X(0xB0, mov_reg_imm) X(0xB1, mov_reg_imm) X(0xB2, mov_reg_imm) X(0xB3, mov_reg_imm) \
+	X(0xB4, mov_reg_imm) X(0xB5, mov_reg_imm) X(0xB6, mov_reg_imm) X(0xB7, mov_reg_imm) \
+	X(0xB8, mov_reg_imm) X(0xB9, mov_reg_imm) X(0xBA, mov_reg_imm) X(0xBB, mov_reg_imm) \
+	X(0xBC, mov_reg_imm) X(0xBD, mov_reg_imm) X(0xBE, mov_reg_imm) X(0xBF, mov_reg_imm) \
+	X(0xC0, ret_intra_add_imm) X(0xC1, ret_intra) X(0xC2, ret_intra_add_imm) X(0xC3, ret_intra) \
+	X(0xC4, les) X(0xC5, lds) X(0xC6, mov_rm_imm) X(0xC7, mov_rm_imm) \
+	X(0xC8, ret_inter_add_imm) X(0xC9, ret_inter) X(0xCA, ret_inter_add_imm) X(0xCB, ret_inter) \
+	X(0xCC, int3) X(0xCD, int_) X(0xCE, into) X(0xCF, iret) \
+	X(0xD0, decode_d0) X(0xD1, decode_d0) X(0xD2, decode_d0) X(0xD3, decode_d0) \
+	X(0xD4, aam) X(0xD5, aad) X(0xD6, salc) X(0xD7, xlat) \
+	X(0xD8, esc) X(0xD9, esc) X(0xDA, esc) X(0xDB, esc) \
+	X(0xDC, esc) X(0xDD, esc) X(0xDE, esc) X(0xDF, esc) \
+	X(0xE0, loopnz) X(0xE1, loopz) X(0xE2, loop) X(0xE3, jcxz) \
+	X(0xE4, in_accum_imm) X(0xE5, in_accum_imm) X(0xE6, out_accum_imm) X(0xE7, out_accum_imm) \
+	X(0xE8, call_intra_direct) X(0xE9, jmp_intra_direct) X(0xEA, jmp_inter_direct) X(0xEB, jmp_intra_direct_short) \
+	X(0xEC, in_accum_dx) X(0xED, in_accum_dx) X(0xEE, out_accum_dx) X(0xEF, out_accum_dx) \
+	X(0xF0, lock) X(0xF1, lock) X(0xF2, rep) X(0xF3, rep) \
+	X(0xF4, hlt) X(0xF5, cmc) X(0xF6, decode_f6) X(0xF7, decode_f6) \
+	X(0xF8, clc) X(0xF9, stc) X(0xFA, cli) X(0xFB, sti) \
+	X(0xFC, cld) X(0xFD, std) X(0xFE, decode_fe) X(0xFF, decode_fe)
+
+#if defined(I8086_DISPATCH_THREADED) && (defined(__GNUC__) || defined(__clang__))
+#define I8086_DISPATCH_GOTO
+#endif
+
+#if !defined(I8086_DISPATCH_GOTO) || defined(I8086_ENABLE_HOT_BLOCKS)
+#define OPCODE_TABLE_ENTRY(op, name) op_##name,
+static int (*const opcode_table[256])(I8086*) = {
+	I8086_OPCODES(OPCODE_TABLE_ENTRY)
+};
+#undef OPCODE_TABLE_ENTRY
+#endif
+
+#ifdef I8086_DISPATCH_GOTO
+/* Computed goto dispatch. Each opcode gets its own indirect jump, prefix bytes
+	jump straight to the next opcode instead of returning to the decode loop. */
+static int i8086_decode_instruction(I8086* cpu) {
+#define OPCODE_LABEL_ENTRY(op, name) &&l_##op,
+	static void* const labels[256] = {
+		I8086_OPCODES(OPCODE_LABEL_ENTRY)
+	};
+#undef OPCODE_LABEL_ENTRY
+	int r = 0;
+	goto *labels[cpu->opcode];
+
+#define OPCODE_LABEL(op, name) l_##op: \
+	r = op_##name(cpu); \
+	if (r == I8086_DECODE_REQ_CYCLE) goto *labels[cpu->opcode]; \
+	return r;
+	I8086_OPCODES(OPCODE_LABEL)
+#undef OPCODE_LABEL
+}
+#else
+static int i8086_decode_instruction(I8086* cpu) {
+	int r = 0;
+	do {
+		r = opcode_table[cpu->opcode](cpu);
+	} while (r == I8086_DECODE_REQ_CYCLE);
+	return r;
+}
+#endif
+
+#ifdef I8086_ENABLE_HOT_BLOCKS
+OPCODE_VOID(add_rm_imm)
+OPCODE_VOID(or_rm_imm)
+OPCODE_VOID(adc_rm_imm)
+OPCODE_VOID(sbb_rm_imm)
+OPCODE_VOID(and_rm_imm)
+OPCODE_VOID(sub_rm_imm)
+OPCODE_VOID(xor_rm_imm)
+OPCODE_VOID(cmp_rm_imm)
+OPCODE_VOID(rol)
+OPCODE_VOID(ror)
+OPCODE_VOID(rcl)
+OPCODE_VOID(rcr)
+OPCODE_VOID(shl)
+OPCODE_VOID(shr)
+OPCODE_VOID(setmo)
+OPCODE_VOID(sar)
+OPCODE_VOID(test_rm_imm)
+OPCODE_VOID(not)
+OPCODE_VOID(neg)
+OPCODE_VOID(mul_rm)
+OPCODE_VOID(imul_rm)
+OPCODE_VOID(div_rm)
+OPCODE_VOID(idiv_rm)
+
+static int (*const hot_80_table[8])(I8086*) = {
+	op_add_rm_imm, op_or_rm_imm, op_adc_rm_imm, op_sbb_rm_imm, op_and_rm_imm, op_sub_rm_imm, op_xor_rm_imm, op_cmp_rm_imm
+};
+static int (*const hot_d0_table[8])(I8086*) = {
+	op_rol, op_ror, op_rcl, op_rcr, op_shl, op_shr, op_setmo, op_sar
+};
+static int (*const hot_f6_table[8])(I8086*) = {
+	op_test_rm_imm, op_test_rm_imm, op_not, op_neg, op_mul_rm, op_imul_rm, op_div_rm, op_idiv_rm
+};
+
+/* Resolve the handler of a hot cache entry. Group opcodes resolve to the
+	routine selected by the mod r/m reg field; the handler is entered with
+	the mod r/m byte already fetched. */
+static void i8086_resolve_hot_handler(I8086_CACHE_ENTRY* entry) {
+	uint8_t n = entry->prefix_len + 1;
+	uint8_t reg = 0;
+
+	entry->handler = opcode_table[entry->opcode];
+	entry->modrm_len = 0;
+
+	if (n >= entry->len) {
+		return;
+	}
+
+	reg = (entry->bytes[n] >> 3) & 0x7;
+	switch (entry->opcode) {
+		case 0x80:
+		case 0x81:
+		case 0x82:
+		case 0x83:
+			entry->handler = hot_80_table[reg];
+			entry->modrm_len = 1;
+			break;
+		case 0xD0:
+		case 0xD1:
+		case 0xD2:
+		case 0xD3:
+			entry->handler = hot_d0_table[reg];
+			entry->modrm_len = 1;
+			break;
+		case 0xF6:
+		case 0xF7:
+			entry->handler = hot_f6_table[reg];
+			entry->modrm_len = 1;
+			break;
+		case 0xFE:
+		case 0xFF:
+			entry->handler = opcode_fe_table[reg];
+			entry->modrm_len = 1;
+			break;
+	}
+}
+#endif
+#endif
 
 void i8086_init(I8086* cpu) {
+	cpu->funcs.user = NULL;
 	cpu->funcs.read_mem_byte = NULL;
 	cpu->funcs.write_mem_byte = NULL;
 	cpu->funcs.read_io_byte = NULL;
 	cpu->funcs.write_io_byte = NULL;
+	cpu->funcs.read_mem_word = NULL;
+	cpu->funcs.write_mem_word = NULL;
+	cpu->funcs.read_io_word = NULL;
+	cpu->funcs.write_io_word = NULL;
+	cpu->funcs.inta = NULL;
+
+	cpu->breakpoint_count = 0;
+
+#ifdef I8086_ENABLE_ASYNC_INTERRUPTS
+	cpu->async_events = 0;
+#endif
+
+#ifdef I8086_ENABLE_LAZY_FLAGS
+	cpu->lazy.op = LAZY_NONE;
+#endif
+
+#ifdef I8086_ENABLE_MEMORY_MAP
+	for (int i = 0; i < I8086_PAGE_COUNT; ++i) {
+		cpu->read_pages[i] = NULL;
+		cpu->write_pages[i] = NULL;
+	}
+#endif
+
+#ifdef I8086_ENABLE_DECODE_CACHE
+	cpu->cache = NULL;
+	cpu->cache_ptr = NULL;
+	cpu->cache_end = NULL;
+#endif
+
+#ifdef I8086_ENABLE_POSTED_IO
+	cpu->posted_io = NULL;
+#endif
+
+#ifdef I8086_ENABLE_SCHEDULER
+	for (int i = 0; i < I8086_MAX_EVENTS; ++i) {
+		cpu->events[i].cb = NULL;
+		cpu->events[i].user = NULL;
+		cpu->events[i].heap_index = I8086_EVENT_IDLE;
+	}
+	cpu->event_count = 0;
+#endif
 
 #ifdef I8086_ENABLE_INTERRUPT_HOOKS
 	cpu->int_cb_count = 0;
@@ -3125,21 +4204,26 @@ void i8086_reset(I8086* cpu) {
 	}
 
 	for (int i = 0; i < I8086_SEGMENT_COUNT; ++i) {
-		cpu->segments[i] = 0;
+		seg_write(cpu, i, 0);
 	}
 
 	IP = 0;
-	CS = 0xFFFF;
+	seg_write(cpu, SEG_CS, 0xFFFF);
 
 	PSW = 0;
+	DISCARD_FLAGS();
 	cpu->opcode = 0;
 	cpu->modrm.byte = 0;
 	cpu->cycles = 0;
 	cpu->internal_flags = 0;
 	cpu->segment_prefix = 0xFF;
 	cpu->instruction_len = 0;
+	cpu->prefix_cycles = 0;
+	cpu->run_end = 0;
 
 	cpu->intr = 0;
+	cpu->intr_line = 0;
+	cpu->intr_edge = 0;
 	cpu->nmi = 0;
 
 	cpu->ea_offset = 0;
@@ -3149,13 +4233,209 @@ void i8086_reset(I8086* cpu) {
 	cpu->int_latch = 0;
 	cpu->int_delay = 0;
 	cpu->intr_type = 0;
+	cpu->halted = 0;
+	cpu->pending = 0;
 }
 
-int i8086_execute(I8086* cpu) {
-	i8086_check_interrupts(cpu);
-	i8086_fetch(cpu);	 
+#ifdef I8086_ENABLE_DECODE_CACHE
+/* Fetch, decode the next instruction through the decode cache */
+static int i8086_fetch_decode(I8086* cpu) {
+	I8086_DECODE_CACHE* cache = cpu->cache;
+	int r = 0;
+
+	if (cache == NULL) {
+		i8086_fetch(cpu);
+		return i8086_decode_instruction(cpu);
+	}
+
+	uint16_t ip = IP;
+	uint20_t addr = I8086_BASE_ADDRESS(SEG_BASE(SEG_CS), ip);
+	I8086_CACHE_ENTRY* entry = i8086_cache_lookup(cache, addr);
+
+	/* the entry was decoded where its bytes were contiguous; from this CS:IP they wrap the segment */
+	if (entry != NULL && (uint32_t)ip + entry->len > 0x10000) {
+		entry = NULL;
+	}
+
+	if (entry != NULL) {
+		/* replay the prefix state; the opcode and operands come from the entry */
+		cpu->internal_flags = entry->internal_flags;
+		cpu->modrm.byte = 0;
+		cpu->segment_prefix = entry->segment_prefix;
+		cpu->instruction_len = entry->prefix_len + 1;
+		cpu->prefix_cycles = entry->prefix_cycles;
+		cpu->opcode = entry->opcode;
+		IP += entry->prefix_len + 1;
+		CYCLES(entry->prefix_cycles);
+
+		cpu->cache_ptr = entry->bytes + entry->prefix_len + 1;
+		cpu->cache_end = entry->bytes + entry->len;
+#ifdef I8086_ENABLE_HOT_BLOCKS
+		if (entry->handler != NULL) {
+			if (entry->modrm_len) {
+				cpu->modrm.byte = *cpu->cache_ptr++;
+				IP += 1;
+				cpu->instruction_len += 1;
+			}
+			r = entry->handler(cpu);
+		}
+		else {
+			if (++entry->count >= I8086_HOT_COUNT) {
+				i8086_resolve_hot_handler(entry);
+			}
+			r = i8086_decode_instruction(cpu);
+		}
+#else
+		r = i8086_decode_instruction(cpu);
+#endif
+		cpu->cache_ptr = NULL;
+		cpu->cache_end = NULL;
+		return r;
+	}
+
+	i8086_cache_record(cache, addr);
+	i8086_fetch(cpu);
+	r = i8086_decode_instruction(cpu);
+	if (r == I8086_DECODE_UNDEFINED) {
+		cache->recording = 0;
+	}
+	else {
+		i8086_cache_insert(cache, ip);
+	}
+	return r;
+}
+#else
+static int i8086_fetch_decode(I8086* cpu) {
+	i8086_fetch(cpu);
 	return i8086_decode_instruction(cpu);
 }
+#endif
+
+int i8086_execute(I8086* cpu) {
+	int r = 0;
+	cpu->run_end = 0; /* single step; rep string instructions do one iteration */
+#ifdef I8086_ENABLE_SCHEDULER
+	i8086_sched_update(cpu, 0);
+#endif
+#ifdef I8086_ENABLE_ASYNC_INTERRUPTS
+	if (ASYNC_LOAD(&cpu->async_events) != 0) {
+		i8086_async_poll(cpu);
+	}
+#endif
+	if (cpu->pending != 0) {
+		i8086_check_interrupts(cpu);
+	}
+	if (cpu->halted) {
+		CYCLES(2);
+		return I8086_DECODE_OK;
+	}
+	r = i8086_fetch_decode(cpu);
+	SYNC_FLAGS();
+	return r;
+}
+
+static int i8086_check_breakpoints(I8086* cpu) {
+	uint20_t addr = I8086_BASE_ADDRESS(SEG_BASE(SEG_CS), IP);
+	for (uint8_t i = 0; i < cpu->breakpoint_count; ++i) {
+		if (cpu->breakpoints[i] == addr) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+I8086_RUN_RESULT i8086_run(I8086* cpu, uint64_t cycle_budget) {
+	I8086_RUN_RESULT result;
+	uint64_t start = cpu->cycles;
+	uint64_t end = start + cycle_budget;
+	int r = 0;
+	int first = 1;
+
+	result.reason = I8086_STOP_BUDGET;
+	cpu->run_end = end;
+#ifdef I8086_ENABLE_SCHEDULER
+	cpu->run_end = i8086_sched_update(cpu, end);
+#endif
+
+	while (cpu->cycles < end) {
+
+#ifdef I8086_ENABLE_SCHEDULER
+		/* Reached the next deadline; call the due events */
+		if (cpu->cycles >= cpu->run_end) {
+			cpu->run_end = i8086_sched_update(cpu, end);
+		}
+#endif
+
+		/* Breakpoints are checked before the instruction boundary. The first
+			instruction is not checked so a run can resume from a breakpoint. */
+		if (cpu->breakpoint_count != 0 && !first && !cpu->halted && i8086_check_breakpoints(cpu)) {
+			result.reason = I8086_STOP_BREAKPOINT;
+			break;
+		}
+		first = 0;
+
+#ifdef I8086_ENABLE_ASYNC_INTERRUPTS
+		if (ASYNC_LOAD(&cpu->async_events) != 0) {
+			i8086_async_poll(cpu);
+		}
+#endif
+		if (cpu->pending != 0) {
+			i8086_check_interrupts(cpu);
+		}
+
+		/* Halted; nothing happens until an interrupt. Skip to the next event or the end of the budget */
+		if (cpu->halted) {
+#ifdef I8086_ENABLE_SCHEDULER
+			cpu->cycles = cpu->run_end;
+			if (cpu->cycles < end) {
+				continue;
+			}
+#else
+			cpu->cycles = end;
+#endif
+			result.reason = I8086_STOP_HALT;
+			break;
+		}
+
+		r = i8086_fetch_decode(cpu);
+
+		if (r == I8086_DECODE_UNDEFINED) {
+			result.reason = I8086_STOP_UNDEFINED;
+			break;
+		}
+	}
+
+	SYNC_FLAGS();
+
+	result.cycles = cpu->cycles - start;
+	return result;
+}
+
+void i8086_set_breakpoint(I8086* cpu, uint16_t segment, uint16_t offset) {
+	uint20_t addr = i8086_get_physical_address(segment, offset);
+	// Ignore if breakpoint is already present
+	for (uint8_t i = 0; i < cpu->breakpoint_count; ++i) {
+		if (cpu->breakpoints[i] == addr) {
+			return;
+		}
+	}
+	// Add new if space
+	if (cpu->breakpoint_count < I8086_MAX_BREAKPOINTS) {
+		cpu->breakpoints[cpu->breakpoint_count] = addr;
+		cpu->breakpoint_count++;
+	}
+}
+void i8086_remove_breakpoint(I8086* cpu, uint16_t segment, uint16_t offset) {
+	uint20_t addr = i8086_get_physical_address(segment, offset);
+	for (uint8_t i = 0; i < cpu->breakpoint_count; ++i) {
+		if (cpu->breakpoints[i] == addr) {
+			// Move last entry to this slot
+			cpu->breakpoints[i] = cpu->breakpoints[cpu->breakpoint_count - 1];
+			cpu->breakpoint_count--;
+			return;
+		}
+	}
+}
 
 #ifdef I8086_ENABLE_INTERRUPT_HOOKS
 void i8086_set_interrupt_cb(I8086* cpu, I8086_INT_CB hook, uint8_t type) {
@@ -3197,6 +4477,41 @@ I8086_INT_CB i8086_find_interrupt_cb(I8086* cpu, uint8_t type) {
 }
 #endif
 
+#ifdef I8086_ENABLE_DECODE_CACHE
+void i8086_set_decode_cache(I8086* cpu, I8086_DECODE_CACHE* cache) {
+	if (cache != NULL) {
+		i8086_cache_flush(cache);
+	}
+	cpu->cache = cache;
+	cpu->cache_ptr = NULL;
+	cpu->cache_end = NULL;
+}
+#endif
+
+#ifdef I8086_ENABLE_POSTED_IO
+void i8086_set_posted_io(I8086* cpu, I8086_POSTED_IO* io) {
+	if (cpu->posted_io != NULL) {
+		i8086_io_sync(cpu->posted_io);
+	}
+	cpu->posted_io = io;
+}
+#endif
+
+#ifdef I8086_ENABLE_MEMORY_MAP
+void i8086_map_memory(I8086* cpu, uint20_t address, uint32_t size, uint8_t* read, uint8_t* write) {
+	uint32_t first = address >> I8086_PAGE_SHIFT;
+	uint32_t count = size >> I8086_PAGE_SHIFT;
+	for (uint32_t i = 0; i < count && first + i < I8086_PAGE_COUNT; ++i) {
+		cpu->read_pages[first + i] = (read != NULL) ? read + (i << I8086_PAGE_SHIFT) : NULL;
+		cpu->write_pages[first + i] = (write != NULL) ? write + (i << I8086_PAGE_SHIFT) : NULL;
+	}
+}
+#endif
+
+void i8086_set_segment(I8086* cpu, uint8_t segment, uint16_t value) {
+	seg_write(cpu, segment & 0x3, value);
+}
+
 uint20_t i8086_get_physical_address(uint16_t segment, uint16_t address) {
-	return (((uint20_t)segment << 4) + address) & 0xFFFFF;
+	return I8086_PHYSICAL_ADDRESS(segment, address);
 }
@@ -38,12 +38,81 @@
 #define I8086_DECODE_REQ_CYCLE 1 /* prefix bytes and string operations require multiple decode cycles */
 #define I8086_DECODE_UNDEFINED 2 /* undefined instruction */
 
+#define I8086_STOP_BUDGET     0 /* cycle budget was consumed */
+#define I8086_STOP_HALT       1 /* cpu is halted (HLT) waiting for NMI/INTR; the rest of the budget was skipped */
+#define I8086_STOP_UNDEFINED  2 /* undefined instruction */
+#define I8086_STOP_BREAKPOINT 3 /* CS:IP reached a breakpoint */
+
+#define I8086_MAX_BREAKPOINTS 4
+
+#define I8086_PAGE_SHIFT 12
+#define I8086_PAGE_SIZE  (1 << I8086_PAGE_SHIFT)
+#define I8086_PAGE_MASK  (I8086_PAGE_SIZE - 1)
+#define I8086_PAGE_COUNT (0x100000 >> I8086_PAGE_SHIFT)
+
 //#define I8086_ENABLE_INTERRUPT_HOOKS
 
+/* Decode cache. Instructions are cached on their physical CS:IP so a hit skips
+   the prefix decode and the bus fetches. The host allocates the cache (i8086_cache.h)
+   and attaches it with i8086_set_decode_cache() */
+//#define I8086_ENABLE_DECODE_CACHE
+
+/* Hot blocks. A cached instruction that executes I8086_HOT_COUNT times gets its
+   opcode handler resolved once (group opcodes down to the mod r/m reg routine) and
+   is called directly from then on; no host code is generated and the same opcode routines
+   run. Requires I8086_ENABLE_DECODE_CACHE and table dispatch */
+//#define I8086_ENABLE_HOT_BLOCKS
+#define I8086_HOT_COUNT 16
+
+/* Lazy flags. The add/sub/logic/inc/dec ALU ops record the operation and the
+   flags are computed only when an instruction reads them (Jcc, PUSHF, LAHF, ...),
+   on an interrupt and before i8086_execute()/i8086_run() return */
+//#define I8086_ENABLE_LAZY_FLAGS
+
+/* Fast MUL/DIV. MUL/IMUL/DIV/IDIV compute the product or quotient directly with the
+   same flags and divide errors as the microcode emulation (i8086_muldiv.c) */
+//#define I8086_ENABLE_FAST_MULDIV
+
+/* Memory map. Pages of the 1MB address space can point straight at host memory;
+   reads/writes of a mapped page skip read_mem_byte()/write_mem_byte().
+   Unmapped pages (MMIO) still go through the callbacks. See i8086_map_memory() */
+//#define I8086_ENABLE_MEMORY_MAP
+
+/* Event scheduler. Host devices (timers, DMA, display) schedule callbacks on a
+   cpu->cycles deadline. i8086_run() runs straight to the next deadline, calls the
+   due events and carries on; no polling between instructions. See i8086_add_event() */
+//#define I8086_ENABLE_SCHEDULER
+#define I8086_MAX_EVENTS 16
+
+/* Async interrupts. Host threads other than the one running the cpu raise/lower INTR
+   and raise NMI through a lock free word (i8086_async_intr(), i8086_async_set_intr_line(),
+   i8086_async_nmi()). The cpu picks them up at the next instruction boundary */
+//#define I8086_ENABLE_ASYNC_INTERRUPTS
+
+/* Posted IO. OUT to a port marked posted is queued in a lock free ring (i8086_io.h) and
+   handled by a device thread instead of calling write_io_byte() on the cpu thread.
+   IN from a posted port waits for the queued writes first. See i8086_set_posted_io() */
+//#define I8086_ENABLE_POSTED_IO
+
+/* Opcode dispatch. The default is a 256-entry handler table.
+   I8086_DISPATCH_SWITCH:   switch statement
+   I8086_DISPATCH_THREADED: computed goto (GCC/Clang); falls back to the handler table */
+//#define I8086_DISPATCH_SWITCH
+//#define I8086_DISPATCH_THREADED
+
 /* 20bit address */
 typedef uint32_t uint20_t;
 typedef int32_t int20_t;
 
+/* Segment base address; segment << 4 */
+#define I8086_SEGMENT_BASE(segment) ((uint20_t)(segment) << 4)
+
+/* 20bit physical address of a segment base address + 16bit offset */
+#define I8086_BASE_ADDRESS(base, offset) (((base) + (uint16_t)(offset)) & 0xFFFFF)
+
+/* 20bit physical address of segment:offset */
+#define I8086_PHYSICAL_ADDRESS(segment, offset) I8086_BASE_ADDRESS(I8086_SEGMENT_BASE(segment), offset)
+
 #pragma warning( push )
 /* ignore unnamed_structure warning */
 #pragma warning( disable : 4201)
@@ -98,18 +167,34 @@ typedef struct I8086_MOD_RM {
 
 #pragma warning( pop ) 
 
-/* I8086 Function pointers */
+typedef struct I8086 I8086;
+
+/* I8086 Function pointers
+ Each function is called with the cpu instance and I8086_FUNCS.user */
 typedef struct I8086_FUNCS {
-	uint8_t(*read_mem_byte)(uint20_t);  // read mem byte
-	uint8_t(*read_io_byte)(uint16_t);   // read io byte
+	void* user;                                        // host context passed to each function
+
+	uint8_t(*read_mem_byte)(I8086*, void*, uint20_t);  // read mem byte
+	uint8_t(*read_io_byte)(I8086*, void*, uint16_t);   // read io byte
+
+	void(*write_mem_byte)(I8086*, void*, uint20_t, uint8_t);  // write mem byte
+	void(*write_io_byte)(I8086*, void*, uint16_t, uint8_t);   // write io byte
+
+	/* Optional. NULL to use the byte functions. Not called for accesses
+	   that wrap at offset/port 0xFFFF or at the end of the 1MB address space */
+	uint16_t(*read_mem_word)(I8086*, void*, uint20_t);  // read mem word
+	uint16_t(*read_io_word)(I8086*, void*, uint16_t);   // read io word
 
-	void(*write_mem_byte)(uint20_t, uint8_t);  // write mem byte
-	void(*write_io_byte)(uint16_t, uint8_t);   // write io byte
+	void(*write_mem_word)(I8086*, void*, uint20_t, uint16_t); // write mem word
+	void(*write_io_word)(I8086*, void*, uint16_t, uint16_t);  // write io word
+
+	/* Optional. Interrupt acknowledge; called when the cpu accepts INTR and returns the
+	   interrupt type. NULL to use the type passed to i8086_intr() */
+	uint8_t(*inta)(I8086*, void*);
 
 } I8086_FUNCS;
 
 #ifdef I8086_ENABLE_INTERRUPT_HOOKS
-typedef struct I8086 I8086;
 /* I8086 Hook
  cpu: the cpu instance that invoked this hook
  return: 1 if the hook has handled the interrupt.
@@ -123,43 +208,138 @@ typedef struct {
 } I8086_INT_CB_ENTRY;
 #endif
 
+#ifdef I8086_ENABLE_SCHEDULER
+/* I8086 Event
+ cpu: the cpu instance that invoked this event
+ user: the user context given to i8086_add_event()
+ id: the event id. The event can be rescheduled from the callback */
+typedef void (*I8086_EVENT_CB)(I8086* cpu, void* user, int id);
+
+#define I8086_EVENT_IDLE 0xFF /* event is not scheduled */
+typedef struct I8086_EVENT {
+	uint64_t cycles;    // deadline
+	I8086_EVENT_CB cb;  // callback. NULL if the event slot is free
+	void* user;         // user context
+	uint8_t heap_index; // position in the event heap. I8086_EVENT_IDLE if not scheduled
+} I8086_EVENT;
+#endif
+
+#ifdef I8086_ENABLE_LAZY_FLAGS
+/* Last flag setting ALU operation */
+typedef struct I8086_LAZY_FLAGS {
+	uint8_t op;  // operation. LAZY_* (LAZY_NONE if the psw is up to date)
+	uint8_t cf;  // carry flag before an inc/dec
+	uint16_t x;  // operand 1
+	uint16_t y;  // operand 2
+	uint32_t r;  // result; including the carry/borrow bit
+} I8086_LAZY_FLAGS;
+#endif
+
+/* I8086 Run result */
+typedef struct I8086_RUN_RESULT {
+	int reason;      // stop reason. I8086_STOP_*
+	uint64_t cycles; // cycles actually run
+} I8086_RUN_RESULT;
+
 #define INTERNAL_FLAG_F1Z 0x01
 #define INTERNAL_FLAG_F1  0x02
 
-/* I8086 CPU State */
-typedef struct I8086 {
+/* Pending events. Set when the NMI/INTR pins are raised (i8086_nmi(), i8086_intr()), IF/TF
+   change or a MOV/POP SS holds off interrupts. The interrupt check is skipped while none are
+   pending; a host that writes cpu->nmi, cpu->intr or cpu->status directly must set them too */
+#define I8086_PENDING_NMI   0x01 // NMI pin raised
+#define I8086_PENDING_INTR  0x02 // INTR pin raised
+#define I8086_PENDING_DELAY 0x04 // interrupts held off for one instruction
+#define I8086_PENDING_LATCH 0x08 // IF/TF latches need updating or a trap is due
+
+/* Cache line size. The cpu state is aligned to it */
+#define I8086_CACHE_LINE 64
+
+#if defined(_MSC_VER)
+#define I8086_ALIGN(n) __declspec(align(n))
+#else
+#define I8086_ALIGN(n) __attribute__((aligned(n)))
+#endif
+
+/* I8086 CPU State. The state is cache line aligned; a heap allocated instance should
+   use an aligned allocator (_aligned_malloc(), aligned_alloc()).
+   Hot block; the fields used by every instruction. The first cache line holds the
+   registers and the decode state. Cold block; from intr_type, starts on a cache line */
+typedef struct I8086_ALIGN(I8086_CACHE_LINE) I8086 {
+	/* hot block */
 	I8086_REG16 registers[I8086_REGISTER_COUNT]; // general registers
 	uint16_t segments[I8086_SEGMENT_COUNT];      // segment registers
-	I8086_PROGRAM_STATUS_WORD status;            // program status word	
+	uint20_t segment_bases[I8086_SEGMENT_COUNT]; // segment base addresses (segments << 4). Write segments with i8086_set_segment()
+	uint64_t cycles;
 	uint16_t ip;                                 // instruction pointer
+	I8086_PROGRAM_STATUS_WORD status;            // program status word
 	uint8_t opcode;                              // current opcode
 	I8086_MOD_RM modrm;                          // current mod r/m byte (if applicable)
 	uint8_t segment_prefix;                      // current segment override prefix byte (if applicable)
 	uint8_t internal_flags;                      // cpu internal flags
-	uint8_t tf_latch;                            // trap latch
-	uint8_t int_latch;                           // interrupt latch
-	uint8_t int_delay;                           // interrupt delay	
-	uint8_t nmi;                                 // NMI pin
-	uint8_t intr;                                // INTR pin
-	uint8_t intr_type;                           // Hardware interrupt type. 0-255 (INTR)
 	uint8_t instruction_len;
+	uint8_t int_delay;                           // interrupt delay
+	uint8_t int_latch;                           // interrupt latch
+	uint8_t tf_latch;                            // trap latch
+	uint32_t prefix_cycles;                      // cycles taken by the prefix bytes of the current instruction
+
+	uint64_t run_end;                            // cycle the current i8086_run() ends at. 0 when single stepping
+#ifdef I8086_ENABLE_LAZY_FLAGS
+	I8086_LAZY_FLAGS lazy;                       // pending flags of the last ALU op
+#endif
 	uint16_t ea_offset;
 	uint16_t ea_segment;
-	uint64_t cycles;
+	uint8_t halted;                              // HLT was executed; waiting for NMI/INTR
+	uint8_t nmi;                                 // NMI pin
+	uint8_t intr;                                // INTR pin
+	uint8_t intr_line;                           // INTR line level (i8086_set_intr_line()); the pin stays up after INTA
+	uint8_t intr_edge;                           // INTR request latched by i8086_intr(); cleared by INTA
+	uint8_t pending;                             // pending events. I8086_PENDING_*; 0 if there is no interrupt check to do
+	uint8_t breakpoint_count;
+#ifdef I8086_ENABLE_ASYNC_INTERRUPTS
+	volatile long async_events;                  // interrupts posted by other threads; taken at the next instruction boundary
+#endif
+
+#ifdef I8086_ENABLE_DECODE_CACHE
+	struct I8086_DECODE_CACHE* cache;            // decode cache (NULL if none)
+	const uint8_t* cache_ptr;                    // next cached byte of the current instruction
+	const uint8_t* cache_end;                    // end of the cached bytes of the current instruction
+#endif
 
 	I8086_FUNCS funcs;                           // cpu memory function pointers
 
+#ifdef I8086_ENABLE_POSTED_IO
+	struct I8086_POSTED_IO* posted_io;           // posted io (NULL if none)
+#endif
+
+#ifdef I8086_ENABLE_MEMORY_MAP
+	uint8_t* read_pages[I8086_PAGE_COUNT];       // host memory of each page for reads. NULL: read_mem_byte()
+	uint8_t* write_pages[I8086_PAGE_COUNT];      // host memory of each page for writes. NULL: write_mem_byte()
+#endif
+
+	/* cold block */
+	I8086_ALIGN(I8086_CACHE_LINE)
+	uint8_t intr_type;                           // Hardware interrupt type. 0-255 (INTR)
+
+	uint20_t breakpoints[I8086_MAX_BREAKPOINTS]; // breakpoint physical addresses
+
 #ifdef I8086_ENABLE_INTERRUPT_HOOKS
 	I8086_INT_CB_ENTRY int_cb[I8086_MAX_CB];
 	uint8_t int_cb_count;
 #endif
+
+#ifdef I8086_ENABLE_SCHEDULER
+	I8086_EVENT events[I8086_MAX_EVENTS];
+	uint8_t event_heap[I8086_MAX_EVENTS];        // ids of the scheduled events; min heap on the deadline
+	uint8_t event_count;                         // number of scheduled events
+#endif
 } I8086;
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-/* Initialize the CPU. Sets all function pointers to NULL
+/* Initialize the CPU. Sets all function pointers and the user context to NULL
 	cpu: the cpu instance */
 void i8086_init(I8086* cpu);
 
@@ -167,19 +347,83 @@ void i8086_init(I8086* cpu);
 	cpu: the cpu instance */
 void i8086_reset(I8086* cpu);
 
-/* Fetch, Execute the next instruction
+/* Fetch, Execute the next instruction. While halted, a step only checks for interrupts and takes 2 cycles
 	cpu: the cpu instance */
 int i8086_execute(I8086* cpu);
 
-/* request hardware interrupt
+/* Fetch, Execute instructions until the cycle budget is consumed, the cpu is halted, an
+   undefined instruction is executed or a breakpoint is reached. A halted cpu does no work;
+   the cycles are moved to the next event deadline (I8086_ENABLE_SCHEDULER) or the end
+   of the budget. NMI or INTR (with IF set) wake it.
+	cpu: the cpu instance
+	cycle_budget: the number of cycles to run for
+	return: the stop reason and the number of cycles actually run. */
+I8086_RUN_RESULT i8086_run(I8086* cpu, uint64_t cycle_budget);
+
+/* set a breakpoint at seg:offset. i8086_run() stops before executing the instruction.
+	cpu: the cpu instance
+	segment: the breakpoint segment
+	offset: the breakpoint offset */
+void i8086_set_breakpoint(I8086* cpu, uint16_t segment, uint16_t offset);
+
+/* remove a breakpoint at seg:offset
+	cpu: the cpu instance
+	segment: the breakpoint segment
+	offset: the breakpoint offset */
+void i8086_remove_breakpoint(I8086* cpu, uint16_t segment, uint16_t offset);
+
+/* request hardware interrupt. The request is latched until the interrupt is accepted,
+   whatever the level of the INTR line; it is dropped if one is already latched. With
+   an inta callback the type is asked for when the interrupt is accepted instead
 	cpu:  the cpu instance
 	type: the interrupt number 0-0xFF */
 void i8086_intr(I8086* cpu, uint8_t type);
 
+/* set the level of the INTR line. While the line is high, INTR is taken each time IF
+   lets it through; the type comes from the inta callback (or the last i8086_intr() type).
+   An interrupt controller lowers the line from inta once it has nothing else to present.
+	cpu:  the cpu instance
+	level: 1 to raise the line, 0 to lower it */
+void i8086_set_intr_line(I8086* cpu, uint8_t level);
+
 /* request non maskable interrupt
 	cpu:  the cpu instance */
 void i8086_nmi(I8086* cpu);
 
+#ifdef I8086_ENABLE_ASYNC_INTERRUPTS
+/* request hardware interrupt from any thread. Same as i8086_intr() at the next instruction boundary
+	cpu:  the cpu instance
+	type: the interrupt number 0-0xFF */
+void i8086_async_intr(I8086* cpu, uint8_t type);
+
+/* set the level of the INTR line from any thread. Same as i8086_set_intr_line() at the next
+   instruction boundary; the last level set wins
+	cpu:  the cpu instance
+	level: 1 to raise the line, 0 to lower it */
+void i8086_async_set_intr_line(I8086* cpu, uint8_t level);
+
+/* request non maskable interrupt from any thread. Same as i8086_nmi() at the next instruction boundary
+	cpu:  the cpu instance */
+void i8086_async_nmi(I8086* cpu);
+#else
+/* ASYNC INTERRUPTS NOT ENABLED */
+#define i8086_async_intr(cpu, type)
+/* ASYNC INTERRUPTS NOT ENABLED */
+#define i8086_async_set_intr_line(cpu, level)
+/* ASYNC INTERRUPTS NOT ENABLED */
+#define i8086_async_nmi(cpu)
+#endif
+
+/* set a segment register; updates the cached segment base address. Segment registers
+   must not be written directly (cpu->segments) once the cpu is reset.
+	cpu: the cpu instance
+	segment: the segment index. SEG_ES, SEG_CS, SEG_SS, SEG_DS
+	value: the segment value */
+void i8086_set_segment(I8086* cpu, uint8_t segment, uint16_t value);
+
+/* get the 20bit physical address of segment:offset. See I8086_PHYSICAL_ADDRESS()
+	segment: the segment value
+	address: the offset */
 uint20_t i8086_get_physical_address(uint16_t segment, uint16_t address);
 
 #ifdef I8086_ENABLE_INTERRUPT_HOOKS
@@ -207,6 +451,78 @@ I8086_INT_CB i8086_find_interrupt_cb(I8086* cpu, uint8_t type);
 #define i8086_find_interrupt_cb(cpu, type)
 #endif
 
+#ifdef I8086_ENABLE_MEMORY_MAP
+/* map host memory into the address space. RAM maps read and write to the same buffer;
+   ROM maps read only so writes go to write_mem_byte(). The callbacks are still used
+   for unmapped pages and by the disassembler. Host writes into mapped memory must be
+   followed by i8086_cache_invalidate() when a decode cache is attached.
+	cpu: the cpu instance
+	address: the physical address. multiple of I8086_PAGE_SIZE
+	size: the size in bytes. multiple of I8086_PAGE_SIZE
+	read: host memory for reads. NULL to use read_mem_byte()
+	write: host memory for writes. NULL to use write_mem_byte() */
+void i8086_map_memory(I8086* cpu, uint20_t address, uint32_t size, uint8_t* read, uint8_t* write);
+#else
+/* MEMORY MAP NOT ENABLED */
+#define i8086_map_memory(cpu, address, size, read, write)
+#endif
+
+#ifdef I8086_ENABLE_DECODE_CACHE
+/* attach a decode cache. The cache is flushed.
+	cpu: the cpu instance
+	cache: the decode cache. NULL to detach */
+void i8086_set_decode_cache(I8086* cpu, struct I8086_DECODE_CACHE* cache);
+#else
+/* DECODE CACHE NOT ENABLED */
+#define i8086_set_decode_cache(cpu, cache)
+#endif
+
+#ifdef I8086_ENABLE_POSTED_IO
+/* attach a posted io. A device thread must take the queued writes off (i8086_io_peek(),
+   i8086_io_pop()) while the cpu runs. Waits for the writes queued in the previous posted io
+	cpu: the cpu instance
+	io: the posted io. NULL to detach */
+void i8086_set_posted_io(I8086* cpu, struct I8086_POSTED_IO* io);
+#else
+/* POSTED IO NOT ENABLED */
+#define i8086_set_posted_io(cpu, io)
+#endif
+
+#ifdef I8086_ENABLE_SCHEDULER
+/* add an event. The event is not scheduled until i8086_schedule_event()
+	cpu: the cpu instance
+	cb: the event callback function
+	user: the user context passed to the callback
+	return: the event id. -1 if the events are full */
+int i8086_add_event(I8086* cpu, I8086_EVENT_CB cb, void* user);
+
+/* remove an event. The event is cancelled if it is scheduled
+	cpu: the cpu instance
+	id: the event id */
+void i8086_remove_event(I8086* cpu, int id);
+
+/* schedule or reschedule an event. The callback runs on the first instruction boundary
+   at or after the deadline. Deadlines are cpu->cycles values; i8086_reset() sets cycles to 0
+	cpu: the cpu instance
+	id: the event id
+	cycles: the deadline */
+void i8086_schedule_event(I8086* cpu, int id, uint64_t cycles);
+
+/* cancel a scheduled event
+	cpu: the cpu instance
+	id: the event id */
+void i8086_cancel_event(I8086* cpu, int id);
+#else
+/* SCHEDULER NOT ENABLED */
+#define i8086_add_event(cpu, cb, user) (-1)
+/* SCHEDULER NOT ENABLED */
+#define i8086_remove_event(cpu, id)
+/* SCHEDULER NOT ENABLED */
+#define i8086_schedule_event(cpu, id, cycles)
+/* SCHEDULER NOT ENABLED */
+#define i8086_cancel_event(cpu, id)
+#endif
+
 #ifdef __cplusplus
 };
 #endif
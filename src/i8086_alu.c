@@ -7,171 +7,192 @@
 
 #include "i8086.h"
 #include "i8086_alu.h"
+#include "i8086_alu_ops.h"
 #include "i8086_muldiv.h"
 #include "sign_extend.h"
 
-#define SF cpu->status.sf
-#define CF cpu->status.cf
-#define ZF cpu->status.zf
-#define PF cpu->status.pf
-#define OF cpu->status.of
-#define AF cpu->status.af
+/* SF, ZF and PF of an 8bit result */
+#define SZP_PARITY(v) (((v) ^ ((v) >> 1) ^ ((v) >> 2) ^ ((v) >> 3) ^ ((v) >> 4) ^ ((v) >> 5) ^ ((v) >> 6) ^ ((v) >> 7)) & 1 ? 0 : SZP_PF)
+#define SZP(v)   (((v) & SZP_SF) | ((v) == 0 ? SZP_ZF : 0) | SZP_PARITY(v))
+#define SZP4(v)  SZP(v), SZP((v) + 1), SZP((v) + 2), SZP((v) + 3)
+#define SZP16(v) SZP4(v), SZP4((v) + 4), SZP4((v) + 8), SZP4((v) + 12)
+#define SZP64(v) SZP16(v), SZP16((v) + 16), SZP16((v) + 32), SZP16((v) + 48)
 
-#define SET_ZF(r) ZF = (r) == 0
+const uint8_t alu_szp_table[256] = {
+	SZP64(0), SZP64(64), SZP64(128), SZP64(192)
+};
 
-#define SET_SF8(r) SF = ((r) & 0x80) >> 7
-#define SET_ZF8(r) SET_ZF(r)
-
-#define SET_PF8(r) { \
-	uint8_t pf = (r);\
-	pf ^= (pf >> 4); \
-	pf ^= (pf >> 2); \
-	pf ^= (pf >> 1); \
-	PF = (~pf) & 1; }
-
-#define SET_AF_ADD8(x,y,r) AF = (((x) ^ (y) ^ (r)) & 0x10) != 0
-#define SET_AF_SUB8(x,y,r) AF = (((uint8_t)(x) ^ (uint8_t)(y) ^ (uint8_t)(r)) & 0x10) != 0
-#define SET_OF_ADD8(x,y,r) OF = ((((r) ^ (x)) & ((r) ^ (y))) & 0x80) != 0
-#define SET_OF_SUB8(x,y,r) OF = ((((uint8_t)(x) ^ (uint8_t)(y)) & ((uint8_t)(x) ^ (uint8_t)(r))) & 0x80) != 0
-#define SET_CF_ADD8(r)     CF = (r) > 0xFF
-#define SET_CF_SUB8(x,y)   CF = (y) > (x)
-
-#define SET_SF16(r) SF = ((r) & 0x8000) >> 15
-#define SET_ZF16(r) SET_ZF(r)
-
-#define SET_PF16(r) SET_PF8(r & 0xFF)
-
-#define SET_AF_ADD16(x,y,r) AF = (((x) ^ (y) ^ (r)) & 0x10) != 0
-#define SET_AF_SUB16(x,y,r) AF = (((uint16_t)(x) ^ (uint16_t)(y) ^ (uint16_t)(r)) & 0x10) != 0
-#define SET_OF_ADD16(x,y,r) OF = ((((r) ^ (x)) & ((r) ^ (y))) & 0x8000) != 0
-#define SET_OF_SUB16(x,y,r) OF = ((((uint16_t)(x) ^ (uint16_t)(y)) & ((uint16_t)(x) ^ (uint16_t)(r))) & 0x8000) != 0
-#define SET_CF_ADD16(r)     CF = (r) > 0xFFFF
-#define SET_CF_SUB16(x,y)   CF = (y) > (x)
+/* MUL/DIV implementation */
+#ifdef I8086_ENABLE_FAST_MULDIV
+#define MULDIV(name) fast_##name
+#else
+#define MULDIV(name) mc_##name
+#endif
 
 /* DBZ */
 #define INT_DBZ 0 // ITC 0
 extern void i8086_int(I8086* cpu, uint8_t type);
 
-void alu_daa(I8086* cpu, uint8_t* x1) {
-	uint8_t correction = 0;
-	uint8_t af = AF;
-	uint8_t cf = CF;
-
-	uint16_t check_val = 0;
-	if (af) {
-		check_val = 0x9F;
-	}
-	else {
-		check_val = 0x99;
-	}
-
-	if ((*x1 & 0x0F) > 9 || af) {
-		correction |= 0x06;
-		af = 1;
-	}
-	else {
-		af = 0;
-	}
-
-	if (*x1 > check_val || cf) {
-		correction |= 0x60;
-		cf = 1;
-	}
-	else {
-		cf = 0;
-	}
-
-	alu_add8(cpu, x1, correction);
+#ifdef I8086_ENABLE_LAZY_FLAGS
+void alu_sync_flags(I8086* cpu) {
+	uint16_t x = cpu->lazy.x;
+	uint16_t y = cpu->lazy.y;
+	uint32_t r = cpu->lazy.r;
+
+	switch (cpu->lazy.op) {
+		case LAZY_ADD8:
+			EVAL_ADD8(x, y, r);
+			break;
+		case LAZY_SUB8:
+			EVAL_SUB8(x, y, r);
+			break;
+		case LAZY_LOGIC8:
+			EVAL_LOGIC8(r);
+			break;
+		case LAZY_INC8:
+			EVAL_INC8(x, r);
+			CF = cpu->lazy.cf;
+			break;
+		case LAZY_DEC8:
+			EVAL_DEC8(x, r);
+			CF = cpu->lazy.cf;
+			break;
+		case LAZY_ADD16:
+			EVAL_ADD16(x, y, r);
+			break;
+		case LAZY_SUB16:
+			EVAL_SUB16(x, y, r);
+			break;
+		case LAZY_LOGIC16:
+			EVAL_LOGIC16(r);
+			break;
+		case LAZY_INC16:
+			EVAL_INC16(x, r);
+			CF = cpu->lazy.cf;
+			break;
+		case LAZY_DEC16:
+			EVAL_DEC16(x, r);
+			CF = cpu->lazy.cf;
+			break;
+	}
+	cpu->lazy.op = LAZY_NONE;
+}
+uint8_t alu_lazy_cf(I8086* cpu) {
+	switch (cpu->lazy.op) {
+		case LAZY_ADD8:
+		case LAZY_SUB8:
+			return (cpu->lazy.r >> 8) & 1;
+		case LAZY_ADD16:
+		case LAZY_SUB16:
+			return (cpu->lazy.r >> 16) & 1;
+		case LAZY_LOGIC8:
+		case LAZY_LOGIC16:
+			return 0;
+		case LAZY_INC8:
+		case LAZY_DEC8:
+		case LAZY_INC16:
+		case LAZY_DEC16:
+			return cpu->lazy.cf;
+	}
+	return CF;
+}
+#endif
+
+/* BCD adjust tables. The result and the flag image of DAA/DAS/AAA/AAS for every
+	AL, AF and CF; indexed by BCD_INDEX(). Built at compile time like alu_szp_table */
+#define BCD_FLAGS 0x08D5 /* OF, SF, ZF, AF, PF, CF */
+#define BCD_INDEX(x) (((uint16_t)AF << 9) | ((uint16_t)CF << 8) | (x))
+
+/* AL, CF and AF of a table index */
+#define BCD_AL(i) ((i) & 0xFF)
+#define BCD_CF(i) (((i) >> 8) & 1)
+#define BCD_AF(i) (((i) >> 9) & 1)
+
+/* DAA/DAS: low nibble adjust (AF out) and high nibble adjust (CF out) */
+#define BCD_ADJ_LO(i) ((BCD_AL(i) & 0x0F) > 9 || BCD_AF(i))
+#define BCD_ADJ_HI(i) (BCD_AL(i) > (BCD_AF(i) ? 0x9F : 0x99) || BCD_CF(i))
+#define BCD_CORRECTION(i) ((BCD_ADJ_LO(i) ? 0x06 : 0) | (BCD_ADJ_HI(i) ? 0x60 : 0))
+
+/* DAA adds the correction; OF, SF, ZF and PF are those of the add */
+#define DAA_SUM(i) (BCD_AL(i) + BCD_CORRECTION(i))
+#define DAA_RESULT(i) (DAA_SUM(i) & 0xFF)
+#define DAA_OF(i) (((DAA_SUM(i) ^ BCD_AL(i)) & (DAA_SUM(i) ^ BCD_CORRECTION(i)) & 0x80) != 0)
+#define DAA(i) { DAA_RESULT(i), (DAA_OF(i) << 11) | SZP(DAA_RESULT(i)) | (BCD_ADJ_LO(i) << 4) | BCD_ADJ_HI(i) }
+
+/* DAS subtracts the correction; OF, SF, ZF and PF are those of the sub */
+#define DAS_RESULT(i) ((BCD_AL(i) - BCD_CORRECTION(i)) & 0xFF)
+#define DAS_OF(i) (((BCD_AL(i) ^ BCD_CORRECTION(i)) & (BCD_AL(i) ^ DAS_RESULT(i)) & 0x80) != 0)
+#define DAS(i) { DAS_RESULT(i), (DAS_OF(i) << 11) | SZP(DAS_RESULT(i)) | (BCD_ADJ_LO(i) << 4) | BCD_ADJ_HI(i) }
+
+/* AAA/AAS: ZF and PF are of AL after the +-6, before the high nibble is cleared.
+	SF and OF follow the undocumented 8086 behaviour */
+#define AAA_AL(i) ((BCD_AL(i) + (BCD_ADJ_LO(i) ? 6 : 0)) & 0xFF)
+#define AAA_SF(i) (BCD_AL(i) >= 0x7A && BCD_AL(i) <= 0xF9)
+#define AAA_OF(i) (BCD_AL(i) >= 0x7A && BCD_AL(i) <= 0x7F)
+#define AAA(i) { AAA_AL(i) & 0x0F, (AAA_OF(i) << 11) | (AAA_SF(i) << 7) | (SZP(AAA_AL(i)) & (SZP_ZF | SZP_PF)) | \
+	(BCD_ADJ_LO(i) << 4) | BCD_ADJ_LO(i) }
+
+#define AAS_AL(i) ((BCD_AL(i) - (BCD_ADJ_LO(i) ? 6 : 0)) & 0xFF)
+#define AAS_SF(i) ((!BCD_AF(i) && BCD_AL(i) > 0x7F) || (BCD_AF(i) && (BCD_AL(i) <= 0x05 || BCD_AL(i) >= 0x86)))
+#define AAS_OF(i) (BCD_AF(i) && BCD_AL(i) > 0x7F && BCD_AL(i) <= 0x85)
+#define AAS(i) { AAS_AL(i) & 0x0F, (AAS_OF(i) << 11) | (AAS_SF(i) << 7) | (SZP(AAS_AL(i)) & (SZP_ZF | SZP_PF)) | \
+	(BCD_ADJ_LO(i) << 4) | BCD_ADJ_LO(i) }
+
+#define BCD4(f,i)    f(i), f((i) + 1), f((i) + 2), f((i) + 3)
+#define BCD16(f,i)   BCD4(f, i), BCD4(f, (i) + 4), BCD4(f, (i) + 8), BCD4(f, (i) + 12)
+#define BCD64(f,i)   BCD16(f, i), BCD16(f, (i) + 16), BCD16(f, (i) + 32), BCD16(f, (i) + 48)
+#define BCD256(f,i)  BCD64(f, i), BCD64(f, (i) + 64), BCD64(f, (i) + 128), BCD64(f, (i) + 192)
+#define BCD1024(f)   BCD256(f, 0), BCD256(f, 256), BCD256(f, 512), BCD256(f, 768)
+
+typedef struct BCD_ADJUST {
+	uint8_t result;
+	uint16_t flags;
+} BCD_ADJUST;
+
+static const BCD_ADJUST bcd_daa_table[1024] = { BCD1024(DAA) };
+static const BCD_ADJUST bcd_das_table[1024] = { BCD1024(DAS) };
+static const BCD_ADJUST bcd_aaa_table[1024] = { BCD1024(AAA) };
+static const BCD_ADJUST bcd_aas_table[1024] = { BCD1024(AAS) };
 
-	AF = af;
-	CF = cf;
+void alu_daa(I8086* cpu, uint8_t* x1) {
+	SYNC_FLAGS();
+	const BCD_ADJUST* e = &bcd_daa_table[BCD_INDEX(*x1)];
+	*x1 = e->result;
+	PSW = (PSW & ~BCD_FLAGS) | e->flags;
 }
 void alu_das(I8086* cpu, uint8_t* x1) {
-	uint8_t correction = 0;
-	uint8_t af = AF;
-	uint8_t cf = CF;
-
-	uint16_t check_val = 0;
-	if (af) {
-		check_val = 0x9F;
-	}
-	else {
-		check_val = 0x99;
-	}
-
-	if ((*x1 & 0x0F) > 9 || af) {
-		correction |= 6;
-		af = 1;
-	}
-
-	if (*x1 > check_val || cf) {
-		correction |= 0x60;
-		cf = 1;
-	}
-
-	alu_sub8(cpu, x1, correction);
-
-	AF = af;
-	CF = cf;
+	SYNC_FLAGS();
+	const BCD_ADJUST* e = &bcd_das_table[BCD_INDEX(*x1)];
+	*x1 = e->result;
+	PSW = (PSW & ~BCD_FLAGS) | e->flags;
 }
 void alu_aaa(I8086* cpu, uint8_t* l, uint8_t* h) {
-
-	SF = *l >= 0x7A && *l <= 0xF9;
-	OF = *l >= 0x7A && *l <= 0x7F;
-
-	if ((*l & 0x0F) > 9 || AF) {
-		*l = (*l + 6);
-		*h += 1;
-		AF = 1;
-		CF = 1;
-	}
-	else {
-		AF = 0;
-		CF = 0;
-	}
-
-	SET_ZF8(*l);
-	SET_PF8(*l);
-
-	*l &= 0x0F;
+	SYNC_FLAGS();
+	const BCD_ADJUST* e = &bcd_aaa_table[BCD_INDEX(*l)];
+	*l = e->result;
+	*h += e->flags & 1; /* CF; the adjust carries into AH */
+	PSW = (PSW & ~BCD_FLAGS) | e->flags;
 }
 void alu_aas(I8086* cpu, uint8_t* l, uint8_t* h) {
-
-	SF = (!AF && *l > 0x7F) || (AF && (*l <= 0x05 || *l >= 0x86));
-	OF = (AF && *l > 0x7F && *l <= 0x85);
-
-	if ((*l & 0x0F) > 9 || AF) {
-		*l -= 6;
-		*h -= 1;
-		AF = 1;
-		CF = 1;
-	}
-	else {
-		AF = 0;
-		CF = 0;
-	}
-
-	SET_ZF8(*l);
-	SET_PF8(*l);
-
-	*l &= 0x0F;
+	SYNC_FLAGS();
+	const BCD_ADJUST* e = &bcd_aas_table[BCD_INDEX(*l)];
+	*l = e->result;
+	*h -= e->flags & 1; /* CF; the adjust borrows from AH */
+	PSW = (PSW & ~BCD_FLAGS) | e->flags;
 }
 void alu_aam(I8086* cpu, uint8_t* l, uint8_t* h, uint8_t divisor) {
+	SYNC_FLAGS();
 	
 	if (divisor != 0) {
 		*h = (*l / divisor);
 		*l = (*l % divisor);
-		SET_PF8(*l);
-		SET_SF8(*l);
-		SET_ZF8(*l);
+		SET_SZP8(*l);
 		AF = 0;
 		CF = 0;
 		OF = 0;
 	}
 	else {
-		SET_PF8(0);
-		SET_SF8(0);
-		SET_ZF8(0);
+		SET_SZP8(0);
 		AF = 0;
 		CF = 0;
 		OF = 0;
@@ -187,72 +208,26 @@ void alu_aad(I8086* cpu, uint8_t* l, uint8_t* h, uint8_t divisor) {
 /* 8bit alu */
 
 void alu_add8(I8086* cpu, uint8_t* x1, uint8_t x2) {
-	uint16_t tmp = (*x1 + x2);
-	SET_AF_ADD8(*x1, x2, tmp);
-	SET_OF_ADD8(*x1, x2, tmp);
-	SET_CF_ADD8(tmp);
-	*x1 = (tmp & 0xFF);
-	SET_SF8(*x1);
-	SET_PF8(*x1);
-	SET_ZF8(*x1);
+	ALU_ADD8(*x1, x2);
 }
 void alu_adc8(I8086* cpu, uint8_t* x1, uint8_t x2) {
-	uint16_t tmp = ((uint16_t)*x1 + (uint16_t)x2 + CF);
-	SET_AF_ADD8(*x1, x2, tmp);
-	SET_OF_ADD8(*x1, x2, tmp);
-	SET_CF_ADD8(tmp);
-	*x1 = (tmp & 0xFF);
-	SET_SF8(*x1);
-	SET_PF8(*x1);
-	SET_ZF8(*x1);
+	ALU_ADC8(*x1, x2);
 }
 void alu_sub8(I8086* cpu, uint8_t* x1, uint8_t x2) {
-	uint16_t tmp = (*x1 - x2);
-	SET_AF_SUB8(*x1, x2, tmp);
-	SET_OF_SUB8(*x1, x2, tmp);
-	SET_CF_SUB8(*x1, x2);
-	*x1 = (tmp & 0xFF);
-	SET_SF8(*x1);
-	SET_PF8(*x1);
-	SET_ZF8(*x1);
+	ALU_SUB8(*x1, x2);
 }
 void alu_sbb8(I8086* cpu, uint8_t* x1, uint8_t x2) {
-	uint16_t tmp = ((uint16_t)*x1 - ((uint16_t)x2 + CF));
-	SET_AF_SUB8(*x1, x2, tmp);
-	SET_OF_SUB8(*x1, x2, tmp);
-	SET_CF_SUB8(*x1, ((uint16_t)x2 + CF));
-	*x1 = (tmp & 0xFF);
-	SET_SF8(*x1);
-	SET_PF8(*x1);
-	SET_ZF8(*x1);
+	ALU_SBB8(*x1, x2);
 }
 
 void alu_and8(I8086* cpu, uint8_t* x1, uint8_t x2) {
-	*x1 &= x2;
-	CF = 0;
-	OF = 0;
-	AF = 0;
-	SET_SF8(*x1);
-	SET_PF8(*x1);
-	SET_ZF8(*x1);
+	ALU_AND8(*x1, x2);
 }
 void alu_xor8(I8086* cpu, uint8_t* x1, uint8_t x2) {
-	*x1 ^= x2;
-	CF = 0;
-	OF = 0;
-	AF = 0;
-	SET_SF8(*x1);
-	SET_PF8(*x1);
-	SET_ZF8(*x1);
+	ALU_XOR8(*x1, x2);
 }
 void alu_or8(I8086* cpu, uint8_t* x1, uint8_t x2) {
-	*x1 |= x2;
-	CF = 0;
-	OF = 0;
-	AF = 0;
-	SET_SF8(*x1);
-	SET_PF8(*x1);
-	SET_ZF8(*x1);
+	ALU_OR8(*x1, x2);
 }
 
 void alu_cmp8(I8086* cpu, uint8_t  x1, uint8_t x2) {
@@ -263,129 +238,125 @@ void alu_test8(I8086* cpu, uint8_t x1, uint8_t x2) {
 }
 
 void alu_rcl8(I8086* cpu, uint8_t* x1, uint8_t count) {
-	for (int i = 0; i < count; ++i) {
-		uint8_t cf = CF;
-		CF = (*x1 >> 7) & 1;
-		*x1 = (*x1 << 1) | cf;
+	SYNC_FLAGS();
+	/* rotate the 9bit CF:x1; period of 9 */
+	uint8_t n = count % 9;
+	if (n != 0) {
+		uint16_t v = ((uint16_t)CF << 8) | *x1;
+		v = ((v << n) | (v >> (9 - n))) & 0x1FF;
+		CF = (v >> 8) & 1;
+		*x1 = v & 0xFF;
 	}
 	if (count != 0) {
 		OF = ((*x1 >> 7) & 1) ^ CF;
 	}
 }
 void alu_rcr8(I8086* cpu, uint8_t* x1, uint8_t count) {
-	for (int i = 0; i < count; ++i) {
-		uint8_t cf = CF;
-		CF = (*x1 & 1);
-		*x1 = (*x1 >> 1) | (cf << 7);
+	SYNC_FLAGS();
+	/* rotate the 9bit CF:x1; period of 9 */
+	uint8_t n = count % 9;
+	if (n != 0) {
+		uint16_t v = ((uint16_t)CF << 8) | *x1;
+		v = ((v >> n) | (v << (9 - n))) & 0x1FF;
+		CF = (v >> 8) & 1;
+		*x1 = v & 0xFF;
 	}
 	if (count != 0) {
 		OF = (*x1 >> 7) ^ ((*x1 >> 6) & 1);
 	}
 }
 void alu_rol8(I8086* cpu, uint8_t* x1, uint8_t count) {
-	for (int i = 0; i < count; ++i) {
-		CF = (*x1 >> 7) & 1;
-		*x1 = (*x1 << 1) | CF;
-	}
+	SYNC_FLAGS();
 	if (count != 0) {
+		uint8_t n = count & 7;
+		*x1 = (uint8_t)((*x1 << n) | (*x1 >> (8 - n)));
+		CF = *x1 & 1;
 		OF = ((*x1 >> 7) & 1) ^ CF;
 	}
 }
 void alu_ror8(I8086* cpu, uint8_t* x1, uint8_t count) {
-	for (int i = 0; i < count; ++i) {
-		CF = (*x1 & 1);
-		*x1 = (*x1 >> 1) | (CF << 7);
-	}
+	SYNC_FLAGS();
 	if (count != 0) {
+		uint8_t n = count & 7;
+		*x1 = (uint8_t)((*x1 >> n) | (*x1 << (8 - n)));
+		CF = (*x1 >> 7) & 1;
 		OF = (*x1 >> 7) ^ ((*x1 >> 6) & 1);
 	}
 }
 void alu_shl8(I8086* cpu, uint8_t* x1, uint8_t count) {
-	for (int i = 0; i < count; ++i) {
-		CF = (*x1 >> 7) & 1;
-		*x1 <<= 1;
-	}
+	SYNC_FLAGS();
 	if (count != 0) {
+		CF = count <= 8 ? (*x1 >> (8 - count)) & 1 : 0;
+		*x1 = count < 8 ? (uint8_t)(*x1 << count) : 0;
 		OF = ((*x1 >> 7) & 1) ^ CF;
 		AF = (*x1 & 0x10) != 0;
-		SET_PF8(*x1);
-		SET_SF8(*x1);
-		SET_ZF8(*x1);
+		SET_SZP8(*x1);
 	}
 }
 void alu_shr8(I8086* cpu, uint8_t* x1, uint8_t count) {
-	for (int i = 0; i < count; ++i) {
-		OF = (*x1 >> 7) & 1;
-		CF = (*x1 & 1);
-		*x1 >>= 1;
-	}
+	SYNC_FLAGS();
 	if (count != 0) {
+		/* OF is the msb before the last shift */
+		OF = count == 1 ? (*x1 >> 7) & 1 : 0;
+		CF = count <= 8 ? (*x1 >> (count - 1)) & 1 : 0;
+		*x1 = count < 8 ? *x1 >> count : 0;
 		AF = 0;
-		SET_SF8(*x1);
-		SET_PF8(*x1);
-		SET_ZF8(*x1);
+		SET_SZP8(*x1);
 	}
 }
 void alu_sar8(I8086* cpu, uint8_t* x1, uint8_t count) {
-	for (int i = 0; i < count; ++i) {
-		CF = (*x1 & 1);
-		uint8_t msb = (*x1 & 0x80);
-		*x1 >>= 1;
-		*x1 |= msb;
-	}
+	SYNC_FLAGS();
 	if (count != 0) {
+		/* all sign bits from 8 on */
+		uint8_t n = count < 8 ? count : 8;
+		int16_t sx = (int8_t)*x1;
+		CF = (sx >> (n - 1)) & 1;
+		*x1 = (uint8_t)(sx >> n);
 		OF = 0;
 		AF = 0;
-		SET_SF8(*x1);
-		SET_PF8(*x1);
-		SET_ZF8(*x1);
+		SET_SZP8(*x1);
 	}
 }
 void alu_setmo8(I8086* cpu, uint8_t* x1, uint8_t count) {
+	SYNC_FLAGS();
 	if (count != 0) {
 		*x1 = 0xFF;
 		CF = 0;
 		AF = 0;
 		OF = 0;
-		SET_PF8(*x1);
-		SET_SF8(*x1);
-		SET_ZF8(*x1);
+		SET_SZP8(*x1);
 	}
 }
 
 void alu_inc8(I8086* cpu, uint8_t* x1) {
 	uint16_t tmp = (*x1 + 1);
-	SET_AF_ADD8(*x1, 1, tmp);
-	SET_OF_ADD8(*x1, 1, tmp);
+	FLAGS_INC8(*x1, tmp);
 	*x1 = (tmp & 0xFF);
-	SET_SF8(*x1);
-	SET_PF8(*x1);
-	SET_ZF8(*x1);
 }
 void alu_dec8(I8086* cpu, uint8_t* x1) {
 	uint16_t tmp = (*x1 - 1);
-	SET_AF_SUB8(*x1, 1, tmp);
-	SET_OF_SUB8(*x1, 1, tmp);
+	FLAGS_DEC8(*x1, tmp);
 	*x1 = (tmp & 0xFF);
-	SET_SF8(*x1);
-	SET_PF8(*x1);
-	SET_ZF8(*x1);
 }
 
 void alu_mul8(I8086* cpu, uint8_t multiplicand, uint8_t multiplier, uint8_t* lo, uint8_t* hi) {
-	mc_mul8(cpu, multiplicand, multiplier, 0, lo, hi);
+	SYNC_FLAGS();
+	MULDIV(mul8)(cpu, multiplicand, multiplier, 0, lo, hi);
 }
 void alu_imul8(I8086* cpu, uint8_t multiplicand, uint8_t multiplier, uint8_t* lo, uint8_t* hi) {
-	mc_mul8(cpu, multiplicand, multiplier, 1, lo, hi);
+	SYNC_FLAGS();
+	MULDIV(mul8)(cpu, multiplicand, multiplier, 1, lo, hi);
 }
 
 void alu_div8(I8086* cpu, uint8_t dividend_lo, uint8_t dividend_hi, uint8_t divider, uint8_t* quotient, uint8_t* remainder) {
+	SYNC_FLAGS();
 	uint16_t dividend = ((uint16_t)dividend_hi << 8) | dividend_lo;
-	mc_div8(cpu, dividend, divider, 0, quotient, remainder);
+	MULDIV(div8)(cpu, dividend, divider, 0, quotient, remainder);
 }
 void alu_idiv8(I8086* cpu, uint8_t dividend_lo, uint8_t dividend_hi, uint8_t divider, uint8_t* quotient, uint8_t* remainder) {
+	SYNC_FLAGS();
 	uint16_t dividend = ((uint16_t)dividend_hi << 8) | dividend_lo;
-	mc_div8(cpu, dividend, divider, 1, quotient, remainder);
+	MULDIV(div8)(cpu, dividend, divider, 1, quotient, remainder);
 }
 
 void alu_neg8(I8086* cpu, uint8_t* x1) {
@@ -397,72 +368,26 @@ void alu_neg8(I8086* cpu, uint8_t* x1) {
 /* 16bit alu */
 
 void alu_add16(I8086* cpu, uint16_t* x1, uint16_t x2) {
-	uint32_t tmp = (*x1 + x2);
-	SET_AF_ADD16(*x1, x2, tmp);
-	SET_OF_ADD16(*x1, x2, tmp);
-	SET_CF_ADD16(tmp);
-	*x1 = (tmp & 0xFFFF);
-	SET_SF16(*x1);
-	SET_PF16(*x1);
-	SET_ZF16(*x1);
+	ALU_ADD16(*x1, x2);
 }
 void alu_adc16(I8086* cpu, uint16_t* x1, uint16_t x2) {
-	uint32_t tmp = ((uint32_t)*x1 + (uint32_t)x2 + CF);
-	SET_AF_ADD16(*x1, x2, tmp);
-	SET_OF_ADD16(*x1, x2, tmp);
-	SET_CF_ADD16(tmp);
-	*x1 = (tmp & 0xFFFF);
-	SET_SF16(*x1);
-	SET_PF16(*x1);
-	SET_ZF16(*x1);
+	ALU_ADC16(*x1, x2);
 }
 void alu_sub16(I8086* cpu, uint16_t* x1, uint16_t x2) {
-	uint32_t tmp = (*x1 - x2);
-	SET_AF_SUB16(*x1, x2, tmp);
-	SET_OF_SUB16(*x1, x2, tmp);
-	SET_CF_SUB16(*x1, x2);
-	*x1 = (tmp & 0xFFFF);
-	SET_SF16(*x1);
-	SET_PF16(*x1);
-	SET_ZF16(*x1);
+	ALU_SUB16(*x1, x2);
 }
 void alu_sbb16(I8086* cpu, uint16_t* x1, uint16_t x2) {
-	uint32_t tmp = ((uint32_t)*x1 - ((uint32_t)x2 + CF));
-	SET_AF_SUB16(*x1, x2, tmp);
-	SET_OF_SUB16(*x1, x2, tmp);
-	SET_CF_SUB16(*x1, ((uint32_t)x2 + CF));
-	*x1 = (tmp & 0xFFFF);
-	SET_SF16(*x1);
-	SET_PF16(*x1);
-	SET_ZF16(*x1);
+	ALU_SBB16(*x1, x2);
 }
 
 void alu_and16(I8086* cpu, uint16_t* x1, uint16_t x2) {
-	*x1 &= x2;
-	CF = 0;
-	OF = 0;
-	AF = 0;
-	SET_SF16(*x1);
-	SET_PF16(*x1);
-	SET_ZF16(*x1);
+	ALU_AND16(*x1, x2);
 }
 void alu_xor16(I8086* cpu, uint16_t* x1, uint16_t x2) {
-	*x1 ^= x2;
-	CF = 0;
-	OF = 0;
-	AF = 0;
-	SET_SF16(*x1);
-	SET_PF16(*x1);
-	SET_ZF16(*x1);
+	ALU_XOR16(*x1, x2);
 }
 void alu_or16(I8086*  cpu, uint16_t* x1, uint16_t x2) {
-	*x1 |= x2;
-	CF = 0;
-	OF = 0;
-	AF = 0;
-	SET_SF16(*x1);
-	SET_PF16(*x1);
-	SET_ZF16(*x1);
+	ALU_OR16(*x1, x2);
 }
 
 void alu_cmp16(I8086* cpu, uint16_t  x1, uint16_t x2) {
@@ -473,129 +398,125 @@ void alu_test16(I8086* cpu, uint16_t x1, uint16_t x2) {
 }
 
 void alu_rcl16(I8086* cpu, uint16_t* x1, uint8_t count) {
-	for (int i = 0; i < count; ++i) {
-		uint8_t cf = CF;
-		CF = (*x1 >> 15) & 1;
-		*x1 = (*x1 << 1) | cf;
+	SYNC_FLAGS();
+	/* rotate the 17bit CF:x1; period of 17 */
+	uint8_t n = count % 17;
+	if (n != 0) {
+		uint32_t v = ((uint32_t)CF << 16) | *x1;
+		v = ((v << n) | (v >> (17 - n))) & 0x1FFFF;
+		CF = (v >> 16) & 1;
+		*x1 = v & 0xFFFF;
 	}
 	if (count != 0) {
 		OF = ((*x1 >> 15) & 1) ^ CF;
 	}
 }
 void alu_rcr16(I8086* cpu, uint16_t* x1, uint8_t count) {
-	for (int i = 0; i < count; ++i) {
-		uint8_t cf = CF;
-		CF = (*x1 & 1);		
-		*x1 = (*x1 >> 1) | (cf << 15);
+	SYNC_FLAGS();
+	/* rotate the 17bit CF:x1; period of 17 */
+	uint8_t n = count % 17;
+	if (n != 0) {
+		uint32_t v = ((uint32_t)CF << 16) | *x1;
+		v = ((v >> n) | (v << (17 - n))) & 0x1FFFF;
+		CF = (v >> 16) & 1;
+		*x1 = v & 0xFFFF;
 	}
 	if (count != 0) {
 		OF = (*x1 >> 15) ^ ((*x1 >> 14) & 1);
 	}
 }
 void alu_rol16(I8086* cpu, uint16_t* x1, uint8_t count) {
-	for (int i = 0; i < count; ++i) {
-		CF = (*x1 >> 15) & 1;
-		*x1 = (*x1 << 1) | CF;
-	}
+	SYNC_FLAGS();
 	if (count != 0) {
+		uint8_t n = count & 15;
+		*x1 = (uint16_t)((*x1 << n) | (*x1 >> (16 - n)));
+		CF = *x1 & 1;
 		OF = ((*x1 >> 15) & 1) ^ CF;
 	}
 }
 void alu_ror16(I8086* cpu, uint16_t* x1, uint8_t count) {
-	for (int i = 0; i < count; ++i) {
-		CF = (*x1 & 1);
-		*x1 = (*x1 >> 1) | (CF << 15);
-	}
+	SYNC_FLAGS();
 	if (count != 0) {
+		uint8_t n = count & 15;
+		*x1 = (uint16_t)((*x1 >> n) | (*x1 << (16 - n)));
+		CF = (*x1 >> 15) & 1;
 		OF = (*x1 >> 15) ^ ((*x1 >> 14) & 1);
 	}
 }
 void alu_shl16(I8086* cpu, uint16_t* x1, uint8_t count) {
-	for (int i = 0; i < count; ++i) {
-		CF = (*x1 >> 15) & 1;
-		*x1 <<= 1;	
-	}
+	SYNC_FLAGS();
 	if (count != 0) {
+		CF = count <= 16 ? (*x1 >> (16 - count)) & 1 : 0;
+		*x1 = count < 16 ? (uint16_t)(*x1 << count) : 0;
 		OF = ((*x1 >> 15) & 1) ^ CF;
 		AF = (*x1 & 0x10) != 0;
-		SET_SF16(*x1);
-		SET_PF16(*x1);
-		SET_ZF16(*x1);
+		SET_SZP16(*x1);
 	}
 }
 void alu_shr16(I8086* cpu, uint16_t* x1, uint8_t count) {
-	for (int i = 0; i < count; ++i) {
-		OF = (*x1 >> 15) & 1;
-		CF = (*x1 & 1);
-		*x1 >>= 1;
-	}
+	SYNC_FLAGS();
 	if (count != 0) {
+		/* OF is the msb before the last shift */
+		OF = count == 1 ? (*x1 >> 15) & 1 : 0;
+		CF = count <= 16 ? (*x1 >> (count - 1)) & 1 : 0;
+		*x1 = count < 16 ? *x1 >> count : 0;
 		AF = 0;
-		SET_SF16(*x1);
-		SET_PF16(*x1);
-		SET_ZF16(*x1);
+		SET_SZP16(*x1);
 	}
 }
-void alu_sar16(I8086* cpu, uint16_t* x1, uint8_t count) {	
-	for (int i = 0; i < count; ++i) {
-		CF = (*x1 & 1);
-		uint16_t msb = (*x1 & 0x8000);
-		*x1 >>= 1;
-		*x1 |= msb;
-	}
+void alu_sar16(I8086* cpu, uint16_t* x1, uint8_t count) {
+	SYNC_FLAGS();
 	if (count != 0) {
+		/* all sign bits from 16 on */
+		uint8_t n = count < 16 ? count : 16;
+		int32_t sx = (int16_t)*x1;
+		CF = (sx >> (n - 1)) & 1;
+		*x1 = (uint16_t)(sx >> n);
 		OF = 0;
 		AF = 0;
-		SET_SF16(*x1);
-		SET_PF16(*x1);
-		SET_ZF16(*x1);
+		SET_SZP16(*x1);
 	}
 }
 void alu_setmo16(I8086* cpu, uint16_t* x1, uint8_t count) {
+	SYNC_FLAGS();
 	if (count != 0) {
 		*x1 = 0xFFFF;
 		CF = 0;
 		AF = 0;
 		OF = 0;
-		SET_SF16(*x1);
-		SET_PF16(*x1);
-		SET_ZF16(*x1);
+		SET_SZP16(*x1);
 	}
 }
 
 void alu_inc16(I8086* cpu, uint16_t* x1) {
 	uint32_t tmp = (*x1 + 1);
-	SET_AF_ADD16(*x1, 1, tmp);
-	SET_OF_ADD16(*x1, 1, tmp);
+	FLAGS_INC16(*x1, tmp);
 	*x1 = (tmp & 0xFFFF);
-	SET_SF16(*x1);
-	SET_PF16(*x1);
-	SET_ZF16(*x1);
 }
 void alu_dec16(I8086* cpu, uint16_t* x1) {
 	uint32_t tmp = (*x1 - 1);
-	SET_AF_SUB16(*x1, 1, tmp);
-	SET_OF_SUB16(*x1, 1, tmp);
+	FLAGS_DEC16(*x1, tmp);
 	*x1 = (tmp & 0xFFFF);
-	SET_SF16(*x1);
-	SET_PF16(*x1);
-	SET_ZF16(*x1);
 }
 
 void alu_mul16(I8086* cpu, uint16_t multiplicand, uint16_t multiplier, uint16_t* lo, uint16_t* hi) {
-	mc_mul16(cpu, multiplicand, multiplier, 0, lo, hi);
+	SYNC_FLAGS();
+	MULDIV(mul16)(cpu, multiplicand, multiplier, 0, lo, hi);
 }
 void alu_imul16(I8086* cpu, uint16_t multiplicand, uint16_t multiplier, uint16_t* lo, uint16_t* hi) {
-	mc_mul16(cpu, multiplicand, multiplier, 1, lo, hi);
+	SYNC_FLAGS();
+	MULDIV(mul16)(cpu, multiplicand, multiplier, 1, lo, hi);
 }
 
 void alu_div16(I8086* cpu, uint16_t dividend_lo, uint16_t dividend_hi, uint16_t divider, uint16_t* quotient, uint16_t* remainder) {
+	SYNC_FLAGS();
 	uint32_t dividend = ((uint32_t)dividend_hi << 16) | dividend_lo;
-	mc_div16(cpu, dividend, divider, 0, quotient, remainder);
+	MULDIV(div16)(cpu, dividend, divider, 0, quotient, remainder);
 }
 void alu_idiv16(I8086* cpu, uint16_t dividend_lo, uint16_t dividend_hi, uint16_t divider, uint16_t* quotient, uint16_t* remainder) {
+	SYNC_FLAGS();
 	uint32_t dividend = ((uint32_t)dividend_hi << 16) | dividend_lo;
-	mc_div16(cpu, dividend, divider, 1, quotient, remainder);
+	MULDIV(div16)(cpu, dividend, divider, 1, quotient, remainder);
 }
 
 void alu_neg16(I8086* cpu, uint16_t* x1) {
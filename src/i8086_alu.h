@@ -10,10 +10,40 @@
 
 typedef struct I8086 I8086;
 
+/* Lazy flags (I8086_ENABLE_LAZY_FLAGS). I8086_LAZY_FLAGS.op */
+#define LAZY_NONE    0 /* psw is up to date */
+#define LAZY_ADD8    1
+#define LAZY_SUB8    2
+#define LAZY_LOGIC8  3
+#define LAZY_INC8    4
+#define LAZY_DEC8    5
+#define LAZY_ADD16   6
+#define LAZY_SUB16   7
+#define LAZY_LOGIC16 8
+#define LAZY_INC16   9
+#define LAZY_DEC16   10
+
+/* Bring the psw up to date before the flags are read or partially written.
+   Requires i8086.h to be included first */
+#ifdef I8086_ENABLE_LAZY_FLAGS
+#define SYNC_FLAGS() { if (cpu->lazy.op != LAZY_NONE) alu_sync_flags(cpu); }
+#define DISCARD_FLAGS() cpu->lazy.op = LAZY_NONE
+#else
+#define SYNC_FLAGS()
+#define DISCARD_FLAGS()
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#ifdef I8086_ENABLE_LAZY_FLAGS
+/* compute the flags of the recorded operation into the psw */
+void alu_sync_flags(I8086* cpu);
+/* carry flag of the recorded operation */
+uint8_t alu_lazy_cf(I8086* cpu);
+#endif
+
 void alu_daa(I8086* cpu, uint8_t* x1);
 void alu_das(I8086* cpu, uint8_t* x1);
 void alu_aaa(I8086* cpu, uint8_t* l, uint8_t* h);
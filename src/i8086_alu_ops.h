@@ -0,0 +1,186 @@
+/* i8086_alu_ops.h
+ * Thomas J. Armytage 2025 ( https://github.com/tommojphillips/ )
+ * Intel 8086 ALU flag and operation macros
+ * Shared by the ALU and the specialised opcode handlers. Requires i8086.h and
+ * i8086_alu.h to be included first and a local I8086* cpu in scope.
+ */
+
+#ifndef I8086_ALU_OPS_H
+#define I8086_ALU_OPS_H
+
+#include <stdint.h>
+
+#define SF cpu->status.sf
+#define CF cpu->status.cf
+#define ZF cpu->status.zf
+#define PF cpu->status.pf
+#define OF cpu->status.of
+#define AF cpu->status.af
+#define PSW cpu->status.word
+
+/* SF, ZF and PF of every 8bit result at their psw bit positions. Defined in i8086_alu.c */
+#define SZP_SF   0x80
+#define SZP_ZF   0x40
+#define SZP_PF   0x04
+#define SZP_MASK (SZP_SF | SZP_ZF | SZP_PF)
+extern const uint8_t alu_szp_table[256];
+
+/* Set SF, ZF and PF of a result with one masked psw update */
+#define SET_SZP8(r) PSW = (PSW & ~SZP_MASK) | alu_szp_table[(uint8_t)(r)]
+#define SET_SZP16(r) PSW = (PSW & ~SZP_MASK) | \
+	(alu_szp_table[(uint8_t)(r)] & SZP_PF) | \
+	(((uint16_t)(r) >> 8) & SZP_SF) | \
+	((uint16_t)(r) == 0 ? SZP_ZF : 0)
+
+#define SET_ZF(r) ZF = (r) == 0
+
+#define SET_SF8(r) SF = ((r) & 0x80) >> 7
+#define SET_ZF8(r) SET_ZF(r)
+#define SET_PF8(r) PF = (alu_szp_table[(uint8_t)(r)] >> 2) & 1
+
+#define SET_AF_ADD8(x,y,r) AF = (((x) ^ (y) ^ (r)) & 0x10) != 0
+#define SET_AF_SUB8(x,y,r) AF = (((uint8_t)(x) ^ (uint8_t)(y) ^ (uint8_t)(r)) & 0x10) != 0
+#define SET_OF_ADD8(x,y,r) OF = ((((r) ^ (x)) & ((r) ^ (y))) & 0x80) != 0
+#define SET_OF_SUB8(x,y,r) OF = ((((uint8_t)(x) ^ (uint8_t)(y)) & ((uint8_t)(x) ^ (uint8_t)(r))) & 0x80) != 0
+#define SET_CF_ADD8(r)     CF = (r) > 0xFF
+#define SET_CF_SUB8(x,y)   CF = (y) > (x)
+
+#define SET_SF16(r) SF = ((r) & 0x8000) >> 15
+#define SET_ZF16(r) SET_ZF(r)
+
+#define SET_PF16(r) SET_PF8(r)
+
+#define SET_AF_ADD16(x,y,r) AF = (((x) ^ (y) ^ (r)) & 0x10) != 0
+#define SET_AF_SUB16(x,y,r) AF = (((uint16_t)(x) ^ (uint16_t)(y) ^ (uint16_t)(r)) & 0x10) != 0
+#define SET_OF_ADD16(x,y,r) OF = ((((r) ^ (x)) & ((r) ^ (y))) & 0x8000) != 0
+#define SET_OF_SUB16(x,y,r) OF = ((((uint16_t)(x) ^ (uint16_t)(y)) & ((uint16_t)(x) ^ (uint16_t)(r))) & 0x8000) != 0
+#define SET_CF_ADD16(r)     CF = (r) > 0xFFFF
+#define SET_CF_SUB16(x,y)   CF = (y) > (x)
+
+/* Flags of the add/sub/logic/inc/dec ops from the operands and the unmasked
+   result. A borrow out of a subtraction sets the bit above the result width. */
+#define EVAL_ADD8(x,y,r) { \
+	SET_AF_ADD8(x, y, r); \
+	SET_OF_ADD8(x, y, r); \
+	SET_CF_ADD8(r); \
+	SET_SZP8(r); }
+#define EVAL_SUB8(x,y,r) { \
+	SET_AF_SUB8(x, y, r); \
+	SET_OF_SUB8(x, y, r); \
+	CF = ((r) >> 8) & 1; \
+	SET_SZP8(r); }
+#define EVAL_LOGIC8(r) { \
+	CF = 0; \
+	OF = 0; \
+	AF = 0; \
+	SET_SZP8(r); }
+#define EVAL_INC8(x,r) { \
+	SET_AF_ADD8(x, 1, r); \
+	SET_OF_ADD8(x, 1, r); \
+	SET_SZP8(r); }
+#define EVAL_DEC8(x,r) { \
+	SET_AF_SUB8(x, 1, r); \
+	SET_OF_SUB8(x, 1, r); \
+	SET_SZP8(r); }
+
+#define EVAL_ADD16(x,y,r) { \
+	SET_AF_ADD16(x, y, r); \
+	SET_OF_ADD16(x, y, r); \
+	SET_CF_ADD16(r); \
+	SET_SZP16(r); }
+#define EVAL_SUB16(x,y,r) { \
+	SET_AF_SUB16(x, y, r); \
+	SET_OF_SUB16(x, y, r); \
+	CF = ((r) >> 16) & 1; \
+	SET_SZP16(r); }
+#define EVAL_LOGIC16(r) { \
+	CF = 0; \
+	OF = 0; \
+	AF = 0; \
+	SET_SZP16(r); }
+#define EVAL_INC16(x,r) { \
+	SET_AF_ADD16(x, 1, r); \
+	SET_OF_ADD16(x, 1, r); \
+	SET_SZP16(r); }
+#define EVAL_DEC16(x,r) { \
+	SET_AF_SUB16(x, 1, r); \
+	SET_OF_SUB16(x, 1, r); \
+	SET_SZP16(r); }
+
+#ifdef I8086_ENABLE_LAZY_FLAGS
+/* Record the operation; the flags are computed by alu_sync_flags() when read */
+#define LAZY_FLAGS(o,a,b,res) { \
+	cpu->lazy.op = (o); \
+	cpu->lazy.x = (a); \
+	cpu->lazy.y = (b); \
+	cpu->lazy.r = (res); }
+
+#define READ_CF() (cpu->lazy.op != LAZY_NONE ? alu_lazy_cf(cpu) : CF)
+
+#define FLAGS_ADD8(x,y,r)  LAZY_FLAGS(LAZY_ADD8, x, y, r)
+#define FLAGS_SUB8(x,y,r)  LAZY_FLAGS(LAZY_SUB8, x, y, r)
+#define FLAGS_LOGIC8(r)    LAZY_FLAGS(LAZY_LOGIC8, 0, 0, r)
+#define FLAGS_INC8(x,r)    { cpu->lazy.cf = READ_CF(); LAZY_FLAGS(LAZY_INC8, x, 1, r); }
+#define FLAGS_DEC8(x,r)    { cpu->lazy.cf = READ_CF(); LAZY_FLAGS(LAZY_DEC8, x, 1, r); }
+#define FLAGS_ADD16(x,y,r) LAZY_FLAGS(LAZY_ADD16, x, y, r)
+#define FLAGS_SUB16(x,y,r) LAZY_FLAGS(LAZY_SUB16, x, y, r)
+#define FLAGS_LOGIC16(r)   LAZY_FLAGS(LAZY_LOGIC16, 0, 0, r)
+#define FLAGS_INC16(x,r)   { cpu->lazy.cf = READ_CF(); LAZY_FLAGS(LAZY_INC16, x, 1, r); }
+#define FLAGS_DEC16(x,r)   { cpu->lazy.cf = READ_CF(); LAZY_FLAGS(LAZY_DEC16, x, 1, r); }
+#else
+#define READ_CF() CF
+
+#define FLAGS_ADD8(x,y,r)  EVAL_ADD8(x, y, r)
+#define FLAGS_SUB8(x,y,r)  EVAL_SUB8(x, y, r)
+#define FLAGS_LOGIC8(r)    EVAL_LOGIC8(r)
+#define FLAGS_INC8(x,r)    EVAL_INC8(x, r)
+#define FLAGS_DEC8(x,r)    EVAL_DEC8(x, r)
+#define FLAGS_ADD16(x,y,r) EVAL_ADD16(x, y, r)
+#define FLAGS_SUB16(x,y,r) EVAL_SUB16(x, y, r)
+#define FLAGS_LOGIC16(r)   EVAL_LOGIC16(r)
+#define FLAGS_INC16(x,r)   EVAL_INC16(x, r)
+#define FLAGS_DEC16(x,r)   EVAL_DEC16(x, r)
+#endif
+
+/* Binary ops. x: the destination lvalue, y: the source. x is evaluated more than once */
+#define ALU_ADD8(x,y) { \
+	uint16_t res = (uint16_t)((x) + (y)); \
+	FLAGS_ADD8(x, y, res); \
+	(x) = (uint8_t)res; }
+#define ALU_ADC8(x,y) { \
+	uint16_t res = (uint16_t)((uint16_t)(x) + (uint16_t)(y) + READ_CF()); \
+	FLAGS_ADD8(x, y, res); \
+	(x) = (uint8_t)res; }
+#define ALU_SUB8(x,y) { \
+	uint16_t res = (uint16_t)((x) - (y)); \
+	FLAGS_SUB8(x, y, res); \
+	(x) = (uint8_t)res; }
+#define ALU_SBB8(x,y) { \
+	uint16_t res = (uint16_t)((uint16_t)(x) - ((uint16_t)(y) + READ_CF())); \
+	FLAGS_SUB8(x, y, res); \
+	(x) = (uint8_t)res; }
+#define ALU_AND8(x,y) { (x) &= (y); FLAGS_LOGIC8(x); }
+#define ALU_OR8(x,y)  { (x) |= (y); FLAGS_LOGIC8(x); }
+#define ALU_XOR8(x,y) { (x) ^= (y); FLAGS_LOGIC8(x); }
+
+#define ALU_ADD16(x,y) { \
+	uint32_t res = (uint32_t)((x) + (y)); \
+	FLAGS_ADD16(x, y, res); \
+	(x) = (uint16_t)res; }
+#define ALU_ADC16(x,y) { \
+	uint32_t res = (uint32_t)((uint32_t)(x) + (uint32_t)(y) + READ_CF()); \
+	FLAGS_ADD16(x, y, res); \
+	(x) = (uint16_t)res; }
+#define ALU_SUB16(x,y) { \
+	uint32_t res = (uint32_t)((x) - (y)); \
+	FLAGS_SUB16(x, y, res); \
+	(x) = (uint16_t)res; }
+#define ALU_SBB16(x,y) { \
+	uint32_t res = (uint32_t)((uint32_t)(x) - ((uint32_t)(y) + READ_CF())); \
+	FLAGS_SUB16(x, y, res); \
+	(x) = (uint16_t)res; }
+#define ALU_AND16(x,y) { (x) &= (y); FLAGS_LOGIC16(x); }
+#define ALU_OR16(x,y)  { (x) |= (y); FLAGS_LOGIC16(x); }
+#define ALU_XOR16(x,y) { (x) ^= (y); FLAGS_LOGIC16(x); }
+
+#endif
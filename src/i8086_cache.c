@@ -0,0 +1,146 @@
+/* i8086_cache.c
+ * Thomas J. Armytage 2025 ( https://github.com/tommojphillips/ )
+ * Intel 8086 Decode Cache
+ */
+
+/* Instructions are cached on the physical address of their first byte (CS:IP).
+   An entry holds the raw instruction bytes and the decoded prefix state so a
+   cache hit skips the prefix decode cycles and the bus fetches. A basic block
+   is a run of consecutive entries; it is left on the first taken branch.
+
+   Every byte of a cached instruction is marked in a code bitmap. A write to a
+   marked byte invalidates the (at most I8086_CACHE_MAX_LEN) entries that could
+   contain it, so self modifying code sees its own writes. */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "i8086.h"
+#include "i8086_cache.h"
+
+#define CACHE_INDEX(address) ((address) & (I8086_CACHE_ENTRIES - 1))
+
+#define CODE_TEST(cache, address) ((cache)->code[(address) >> 3] & (1 << ((address) & 7)))
+#define CODE_SET(cache, address) ((cache)->code[(address) >> 3] |= (1 << ((address) & 7)))
+
+static void i8086_cache_invalidate_byte(I8086_DECODE_CACHE* cache, uint20_t address) {
+	for (uint20_t i = 0; i < I8086_CACHE_MAX_LEN; ++i) {
+		uint20_t start = (address - i) & 0xFFFFF;
+		I8086_CACHE_ENTRY* entry = &cache->entries[CACHE_INDEX(start)];
+		if (entry->address == start && i < entry->len) {
+			entry->address = I8086_CACHE_INVALID;
+		}
+	}
+}
+
+void i8086_cache_flush(I8086_DECODE_CACHE* cache) {
+	for (int i = 0; i < I8086_CACHE_ENTRIES; ++i) {
+		cache->entries[i].address = I8086_CACHE_INVALID;
+	}
+	memset(cache->code, 0, sizeof(cache->code));
+	cache->recording = 0;
+	cache->record_len = 0;
+	cache->record_abort = 0;
+}
+
+void i8086_cache_invalidate(I8086_DECODE_CACHE* cache, uint20_t address, uint32_t size) {
+	for (uint32_t i = 0; i < size; ++i) {
+		uint20_t a = (address + i) & 0xFFFFF;
+		if (CODE_TEST(cache, a)) {
+			i8086_cache_invalidate_byte(cache, a);
+		}
+	}
+}
+
+I8086_CACHE_ENTRY* i8086_cache_lookup(I8086_DECODE_CACHE* cache, uint20_t address) {
+	I8086_CACHE_ENTRY* entry = &cache->entries[CACHE_INDEX(address)];
+	if (entry->address == address) {
+		return entry;
+	}
+	return NULL;
+}
+
+void i8086_cache_record(I8086_DECODE_CACHE* cache, uint20_t address) {
+	cache->record_address = address;
+	cache->record_len = 0;
+	cache->record_abort = 0;
+	cache->recording = 1;
+}
+
+void i8086_cache_insert(I8086_DECODE_CACHE* cache, uint16_t ip) {
+	cache->recording = 0;
+
+	if (cache->record_abort || cache->record_len > I8086_CACHE_MAX_LEN) {
+		return;
+	}
+
+	/* the fetches wrapped the segment; the bytes are not contiguous */
+	if ((uint32_t)ip + cache->record_len > 0x10000) {
+		return;
+	}
+
+	I8086_CACHE_ENTRY* entry = &cache->entries[CACHE_INDEX(cache->record_address)];
+	entry->len = cache->record_len;
+	entry->modrm_len = 0;
+	entry->count = 0;
+	entry->handler = NULL;
+	entry->prefix_len = 0;
+	entry->prefix_cycles = 0;
+	entry->segment_prefix = 0xFF;
+	entry->internal_flags = 0;
+
+	/* decode the prefix bytes the same way rep(), segment_override() and lock() do */
+	for (uint8_t i = 0; i < entry->len; ++i) {
+		uint8_t b = cache->record_bytes[i];
+		entry->bytes[i] = b;
+		if (i != entry->prefix_len) {
+			continue;
+		}
+		switch (b) {
+			case 0x26:
+			case 0x2E:
+			case 0x36:
+			case 0x3E:
+				entry->segment_prefix = (b >> 3) & 0x3;
+				entry->prefix_cycles += 2;
+				entry->prefix_len++;
+				break;
+			case 0xF0:
+			case 0xF1:
+				entry->prefix_cycles += 2;
+				entry->prefix_len++;
+				break;
+			case 0xF2:
+			case 0xF3:
+				entry->internal_flags |= INTERNAL_FLAG_F1;
+				entry->internal_flags &= ~INTERNAL_FLAG_F1Z;
+				entry->internal_flags |= (b & 0x1);
+				entry->prefix_cycles += 9;
+				entry->prefix_len++;
+				break;
+		}
+	}
+
+	/* prefix bytes only; the instruction was cut short */
+	if (entry->prefix_len >= entry->len) {
+		entry->address = I8086_CACHE_INVALID;
+		return;
+	}
+
+	entry->opcode = entry->bytes[entry->prefix_len];
+	entry->address = cache->record_address;
+
+	for (uint8_t i = 0; i < entry->len; ++i) {
+		uint20_t a = (entry->address + i) & 0xFFFFF;
+		CODE_SET(cache, a);
+	}
+}
+
+void i8086_cache_write(I8086_DECODE_CACHE* cache, uint20_t address) {
+	if (CODE_TEST(cache, address)) {
+		i8086_cache_invalidate_byte(cache, address);
+	}
+	if (cache->recording && ((address - cache->record_address) & 0xFFFFF) < I8086_CACHE_MAX_LEN) {
+		cache->record_abort = 1;
+	}
+}
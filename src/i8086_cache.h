@@ -0,0 +1,83 @@
+/* i8086_cache.h
+ * Thomas J. Armytage 2025 ( https://github.com/tommojphillips/ )
+ * Intel 8086 Decode Cache
+ */
+
+#ifndef I8086_CACHE_H
+#define I8086_CACHE_H
+
+#include <stdint.h>
+
+#include "i8086.h"
+
+#define I8086_CACHE_ENTRIES  4096       /* number of cached instructions; power of 2 */
+#define I8086_CACHE_MAX_LEN  16         /* max cached instruction length; including prefix bytes */
+#define I8086_CACHE_INVALID  0xFFFFFFFF /* entry is empty */
+
+/* Decoded instruction */
+typedef struct I8086_CACHE_ENTRY {
+	uint20_t address;                   // physical address of the first byte (CS:IP)
+	uint8_t len;                        // instruction length; including prefix bytes
+	uint8_t prefix_len;                 // number of prefix bytes
+	uint8_t prefix_cycles;              // cycles taken by the prefix bytes
+	uint8_t opcode;                     // opcode
+	uint8_t segment_prefix;             // segment override prefix (0xFF if none)
+	uint8_t internal_flags;             // rep prefix state (F1/F1Z)
+	uint8_t bytes[I8086_CACHE_MAX_LEN]; // instruction bytes
+	uint8_t modrm_len;                  // 1 if the handler expects the mod r/m byte already fetched
+	uint16_t count;                     // times executed from the cache (I8086_ENABLE_HOT_BLOCKS)
+	int (*handler)(I8086*);             // resolved opcode handler of a hot entry. NULL until hot
+} I8086_CACHE_ENTRY;
+
+/* Decode Cache. Allocated by the host and attached with i8086_set_decode_cache() (I8086_ENABLE_DECODE_CACHE) */
+typedef struct I8086_DECODE_CACHE {
+	I8086_CACHE_ENTRY entries[I8086_CACHE_ENTRIES]; // direct mapped on the physical address
+	uint8_t code[0x100000 / 8];                      // bitmap of bytes that are part of a cached instruction
+
+	uint20_t record_address;                         // physical address of the instruction being recorded
+	uint8_t record_bytes[I8086_CACHE_MAX_LEN];       // bytes fetched by the instruction being recorded
+	uint8_t record_len;                              // number of bytes fetched
+	uint8_t record_abort;                            // instruction wrote over its own bytes; dont cache it
+	uint8_t recording;                               // an instruction is being recorded
+} I8086_DECODE_CACHE;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Flush all cached instructions
+	cache: the decode cache */
+void i8086_cache_flush(I8086_DECODE_CACHE* cache);
+
+/* Invalidate cached instructions that overlap a physical address range.
+	The host must call this when it writes memory without going through the cpu (DMA, loaders)
+	cache: the decode cache
+	address: the physical address
+	size: the size of the range in bytes */
+void i8086_cache_invalidate(I8086_DECODE_CACHE* cache, uint20_t address, uint32_t size);
+
+/* Find the cached instruction at a physical address. NULL if not cached
+	cache: the decode cache
+	address: the physical address */
+I8086_CACHE_ENTRY* i8086_cache_lookup(I8086_DECODE_CACHE* cache, uint20_t address);
+
+/* Start recording the instruction at a physical address
+	cache: the decode cache
+	address: the physical address of the first byte */
+void i8086_cache_record(I8086_DECODE_CACHE* cache, uint20_t address);
+
+/* Stop recording and cache the recorded instruction
+	cache: the decode cache
+	ip: the offset of the first byte. Instructions that wrap the segment are not cached */
+void i8086_cache_insert(I8086_DECODE_CACHE* cache, uint16_t ip);
+
+/* Notify the cache of a memory write.
+	cache: the decode cache
+	address: the physical address written */
+void i8086_cache_write(I8086_DECODE_CACHE* cache, uint20_t address);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif
@@ -0,0 +1,118 @@
+/* i8086_io.c
+ * Thomas J. Armytage 2025 ( https://github.com/tommojphillips/ )
+ * Intel 8086 Posted IO
+ */
+
+/* OUT to a posted port is queued in the ring instead of calling write_io_byte()/write_io_word()
+   on the cpu thread; a device thread takes the writes off in order and handles them.
+   head and tail only ever increase (mod 2^32) and each has a single writer, so no locks are needed.
+   The producer fills the entry and then publishes it with a release store of head; the consumer
+   releases the entry with a store of tail only after it is handled.
+
+   IN from a posted port waits until tail catches up with head, so every earlier OUT has been
+   handled by the device before read_io_byte() is called. */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "i8086.h"
+#include "i8086_io.h"
+
+#ifdef _MSC_VER
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <intrin.h>
+#define IO_YIELD() SwitchToThread()
+#define IO_LOAD(p) (*(p)) // volatile; acquire on MSVC (/volatile:ms)
+#define IO_STORE(p, v) _InterlockedExchange(p, v)
+#if defined(_M_IX86) || defined(_M_X64)
+#define IO_PAUSE() _mm_pause()
+#else
+#define IO_PAUSE()
+#endif
+#else
+#include <sched.h>
+#define IO_YIELD() sched_yield()
+#define IO_LOAD(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define IO_STORE(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#if defined(__i386__) || defined(__x86_64__)
+#define IO_PAUSE() __builtin_ia32_pause()
+#else
+#define IO_PAUSE()
+#endif
+#endif
+
+/* Waits spin this many times before giving the rest of the time slice away.
+   The device thread may be sharing the core with the cpu thread */
+#define IO_SPIN_COUNT 64
+
+/* Number of queued writes */
+#define IO_COUNT(head, tail) ((uint32_t)(head) - (uint32_t)(tail))
+
+/* Ring entry of a position */
+#define IO_ENTRY(io, i) (&(io)->ring[(uint32_t)(i) & (I8086_IO_RING_SIZE - 1)])
+
+static void io_wait(uint32_t* spins) {
+	if (*spins < IO_SPIN_COUNT) {
+		*spins += 1;
+		IO_PAUSE();
+	}
+	else {
+		IO_YIELD();
+	}
+}
+
+void i8086_io_init(I8086_POSTED_IO* io) {
+	memset(io->posted, 0, sizeof(io->posted));
+	io->head = 0;
+	io->tail = 0;
+}
+
+void i8086_io_set_posted(I8086_POSTED_IO* io, uint16_t port, uint32_t count, uint8_t posted) {
+	for (uint32_t i = 0; i < count && port + i <= 0xFFFF; ++i) {
+		uint16_t p = (uint16_t)(port + i);
+		if (posted) {
+			io->posted[p >> 3] |= (1 << (p & 7));
+		}
+		else {
+			io->posted[p >> 3] &= ~(1 << (p & 7));
+		}
+	}
+}
+
+int i8086_io_is_posted(I8086_POSTED_IO* io, uint16_t port) {
+	return io->posted[port >> 3] & (1 << (port & 7));
+}
+
+void i8086_io_post(I8086_POSTED_IO* io, uint16_t port, uint16_t value, uint8_t word) {
+	long head = io->head; // only this thread writes head
+	uint32_t spins = 0;
+	while (IO_COUNT(head, IO_LOAD(&io->tail)) >= I8086_IO_RING_SIZE) {
+		io_wait(&spins); // full; wait for the device thread
+	}
+	I8086_IO_WRITE* entry = IO_ENTRY(io, head);
+	entry->port = port;
+	entry->value = value;
+	entry->word = word;
+	IO_STORE(&io->head, (long)((uint32_t)head + 1));
+}
+
+void i8086_io_sync(I8086_POSTED_IO* io) {
+	long head = io->head;
+	uint32_t spins = 0;
+	while (IO_LOAD(&io->tail) != head) {
+		io_wait(&spins);
+	}
+}
+
+const I8086_IO_WRITE* i8086_io_peek(I8086_POSTED_IO* io) {
+	long tail = io->tail; // only this thread writes tail
+	if (IO_LOAD(&io->head) == tail) {
+		return NULL;
+	}
+	return IO_ENTRY(io, tail);
+}
+
+void i8086_io_pop(I8086_POSTED_IO* io) {
+	IO_STORE(&io->tail, (long)((uint32_t)io->tail + 1));
+}
@@ -0,0 +1,81 @@
+/* i8086_io.h
+ * Thomas J. Armytage 2025 ( https://github.com/tommojphillips/ )
+ * Intel 8086 Posted IO
+ */
+
+#ifndef I8086_IO_H
+#define I8086_IO_H
+
+#include <stdint.h>
+
+#include "i8086.h"
+
+#define I8086_IO_RING_SIZE 1024 /* number of queued port writes; power of 2 */
+
+/* Posted port write */
+typedef struct I8086_IO_WRITE {
+	uint16_t port;                            // io port
+	uint16_t value;                           // byte or word written
+	uint8_t word;                             // 1 if word write (write_io_word()); 0 if byte write
+} I8086_IO_WRITE;
+
+/* Posted IO. Allocated by the host and attached with i8086_set_posted_io() (I8086_ENABLE_POSTED_IO).
+   A single producer/single consumer ring; the cpu thread queues OUT to a posted port and one
+   device thread takes them off in order */
+typedef struct I8086_POSTED_IO {
+	uint8_t posted[0x10000 / 8];               // bitmap of posted ports
+	I8086_IO_WRITE ring[I8086_IO_RING_SIZE];   // queued port writes
+
+	I8086_ALIGN(I8086_CACHE_LINE)
+	volatile long head;                        // writes queued; only written by the cpu thread
+
+	I8086_ALIGN(I8086_CACHE_LINE)
+	volatile long tail;                        // writes handled; only written by the device thread
+} I8086_POSTED_IO;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* clear the posted ports and empty the ring. Neither thread may be using it
+	io: the posted io */
+void i8086_io_init(I8086_POSTED_IO* io);
+
+/* mark a range of ports as posted or synchronous. Only call while the cpu is not running
+	io: the posted io
+	port: the first port
+	count: the number of ports
+	posted: 1 to post writes to the device thread; 0 to call write_io_byte() on the cpu thread */
+void i8086_io_set_posted(I8086_POSTED_IO* io, uint16_t port, uint32_t count, uint8_t posted);
+
+/* check if a port is posted
+	io: the posted io
+	port: the port
+	return: non zero if posted */
+int i8086_io_is_posted(I8086_POSTED_IO* io, uint16_t port);
+
+/* queue a port write. Waits for the device thread while the ring is full. cpu thread only
+	io: the posted io
+	port: the port
+	value: the byte or word written
+	word: 1 if word write; 0 if byte write */
+void i8086_io_post(I8086_POSTED_IO* io, uint16_t port, uint16_t value, uint8_t word);
+
+/* wait until the device thread has handled every queued write. cpu thread only
+	io: the posted io */
+void i8086_io_sync(I8086_POSTED_IO* io);
+
+/* get the oldest queued write. Device thread only; call i8086_io_pop() once it is handled
+	io: the posted io
+	return: the oldest queued write. NULL if the ring is empty */
+const I8086_IO_WRITE* i8086_io_peek(I8086_POSTED_IO* io);
+
+/* remove the write returned by i8086_io_peek(). Device thread only
+	io: the posted io */
+void i8086_io_pop(I8086_POSTED_IO* io);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif
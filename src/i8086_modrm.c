@@ -0,0 +1,49 @@
+/* i8086_modrm.c
+ * Thomas J. Armytage 2025 ( https://github.com/tommojphillips/ )
+ * Intel 8086 Mod R/M Effective Address Descriptors
+ */
+
+#include <stdint.h>
+
+#include "i8086.h"
+#include "i8086_modrm.h"
+
+#define NONE I8086_EA_NONE
+
+/* { base, index, disp_size, segment, cycles } of r/m 000-111 for a mod */
+#define EA_MOD00 \
+	{ REG_BX, REG_SI, 0, SEG_DS, 0 }, /* [BX+SI] */ \
+	{ REG_BX, REG_DI, 0, SEG_DS, 0 }, /* [BX+DI] */ \
+	{ REG_BP, REG_SI, 0, SEG_SS, 0 }, /* [BP+SI] */ \
+	{ REG_BP, REG_DI, 0, SEG_SS, 0 }, /* [BP+DI] */ \
+	{ REG_SI, NONE,   0, SEG_DS, 0 }, /* [SI] */ \
+	{ REG_DI, NONE,   0, SEG_DS, 0 }, /* [DI] */ \
+	{ NONE,   NONE,   2, SEG_DS, 6 }, /* [disp16] */ \
+	{ REG_BX, NONE,   0, SEG_DS, 0 }  /* [BX] */
+
+#define EA_MOD(disp) \
+	{ REG_BX, REG_SI, disp, SEG_DS, 4 }, /* [BX+SI+disp] */ \
+	{ REG_BX, REG_DI, disp, SEG_DS, 4 }, /* [BX+DI+disp] */ \
+	{ REG_BP, REG_SI, disp, SEG_SS, 4 }, /* [BP+SI+disp] */ \
+	{ REG_BP, REG_DI, disp, SEG_SS, 4 }, /* [BP+DI+disp] */ \
+	{ REG_SI, NONE,   disp, SEG_DS, 4 }, /* [SI+disp] */ \
+	{ REG_DI, NONE,   disp, SEG_DS, 4 }, /* [DI+disp] */ \
+	{ REG_BP, NONE,   disp, SEG_SS, 4 }, /* [BP+disp] */ \
+	{ REG_BX, NONE,   disp, SEG_DS, 4 }  /* [BX+disp] */
+
+/* Register mode; no address. The segment follows r/m as in the memory forms */
+#define EA_MOD11 \
+	{ NONE, NONE, 0, SEG_DS, 0 }, { NONE, NONE, 0, SEG_DS, 0 }, \
+	{ NONE, NONE, 0, SEG_SS, 0 }, { NONE, NONE, 0, SEG_SS, 0 }, \
+	{ NONE, NONE, 0, SEG_DS, 0 }, { NONE, NONE, 0, SEG_DS, 0 }, \
+	{ NONE, NONE, 0, SEG_SS, 0 }, { NONE, NONE, 0, SEG_DS, 0 }
+
+/* The reg field does not take part in the address; each r/m row repeats for reg 000-111 */
+#define EA_REG8(row) row, row, row, row, row, row, row, row
+
+const I8086_MODRM_EA i8086_modrm_ea[256] = {
+	EA_REG8(EA_MOD00),
+	EA_REG8(EA_MOD(1)),
+	EA_REG8(EA_MOD(2)),
+	EA_REG8(EA_MOD11)
+};
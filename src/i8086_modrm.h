@@ -0,0 +1,34 @@
+/* i8086_modrm.h
+ * Thomas J. Armytage 2025 ( https://github.com/tommojphillips/ )
+ * Intel 8086 Mod R/M Effective Address Descriptors
+ */
+
+#ifndef I8086_MODRM_H
+#define I8086_MODRM_H
+
+#include <stdint.h>
+
+#define I8086_EA_NONE 0xFF /* no base/index register */
+
+/* Effective address of a mod r/m byte. mod = b11 (register) entries have no
+   registers and no displacement */
+typedef struct I8086_MODRM_EA {
+	uint8_t base;      // base register index (REG_BX, REG_BP, REG_SI, REG_DI) or I8086_EA_NONE
+	uint8_t index;     // index register index (REG_SI, REG_DI) or I8086_EA_NONE
+	uint8_t disp_size; // displacement size in bytes; 0, 1 (sign extended) or 2
+	uint8_t segment;   // default segment index (SEG_DS, SEG_SS)
+	uint8_t cycles;    // EA calculation cycles
+} I8086_MODRM_EA;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Effective address descriptors; indexed by the mod r/m byte */
+extern const I8086_MODRM_EA i8086_modrm_ea[256];
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif
@@ -3,33 +3,12 @@
  * Intel 8086 MUL/DIV Microcode Emulation
  */
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include "i8086.h"
-
-#define SF cpu->status.sf
-#define CF cpu->status.cf
-#define ZF cpu->status.zf
-#define PF cpu->status.pf
-#define OF cpu->status.of
-#define AF cpu->status.af
-
-#define SET_ZF(r) ZF = (r) == 0
-
-#define SET_PF(r) { \
-	uint8_t pf = (r);\
-	pf ^= (pf >> 4); \
-	pf ^= (pf >> 2); \
-	pf ^= (pf >> 1); \
-	PF = (~pf) & 1; }
-
-#define SET_SF8(r) SF = ((r) & 0x80) >> 7
-#define SET_ZF8(r) SET_ZF(r)
-#define SET_PF8(r) SET_PF(r)
-
-#define SET_SF16(r) SF = ((r) & 0x8000) >> 15
-#define SET_ZF16(r) SET_ZF(r)
-#define SET_PF16(r) SET_PF(r & 0xFF)
+#include "i8086_alu.h"
+#include "i8086_alu_ops.h"
 
 #ifdef I8086_MULDIV_DBG
 #define dbg_print(x) printf(x)
@@ -154,9 +133,7 @@ static int cord8(I8086* cpu, uint8_t* tmpc, uint8_t* tmpa, uint8_t tmpb, uint8_t
 	AF = tmp_af;
 	CF = tmp_cf;
 	OF = tmp_of;
-	SET_SF8(sigma);
-	SET_PF8(sigma);
-	SET_ZF8(sigma);
+	SET_SZP8(sigma);
 	cf = tmp_cf;
 
 	/* 18A: NCY INT0 */
@@ -194,9 +171,7 @@ static int cord8(I8086* cpu, uint8_t* tmpc, uint8_t* tmpa, uint8_t tmpb, uint8_t
 			AF = tmp_af;
 			CF = tmp_cf;
 			OF = tmp_of;
-			SET_SF8(sigma);
-			SET_PF8(sigma);
-			SET_ZF8(sigma);
+			SET_SZP8(sigma);
 			cf = tmp_cf;
 
 			/* 190: NCY 14 */
@@ -418,9 +393,7 @@ void mc_mul8(I8086* cpu, uint8_t multiplicand, uint8_t multiplier, uint8_t is_si
 
 	/* 1CF:/1D3: F */
 	AF = af;
-	SET_SF8(sigma);
-	SET_PF8(sigma);
-	SET_ZF8(sigma);
+	SET_SZP8(sigma);
 
 	/* 1D0: Z 8 */
 	if (sigma != 0) {
@@ -555,9 +528,7 @@ static int cord16(I8086* cpu, uint16_t* tmpc, uint16_t* tmpa, uint16_t tmpb, uin
 	AF = tmp_af;
 	CF = tmp_cf;
 	OF = tmp_of;
-	SET_SF16(sigma);
-	SET_PF16(sigma);
-	SET_ZF16(sigma);
+	SET_SZP16(sigma);
 	cf = tmp_cf;
 
 	/* 18A: NCY INT0 */
@@ -595,9 +566,7 @@ static int cord16(I8086* cpu, uint16_t* tmpc, uint16_t* tmpa, uint16_t tmpb, uin
 			AF = tmp_af;
 			CF = tmp_cf;
 			OF = tmp_of;
-			SET_SF16(sigma);
-			SET_PF16(sigma);
-			SET_ZF16(sigma);
+			SET_SZP16(sigma);
 			cf = tmp_cf;
 
 			/* 190: NCY 14 */
@@ -819,9 +788,7 @@ void mc_mul16(I8086* cpu, uint16_t multiplicand, uint16_t multiplier, uint8_t is
 
 	/* 1CF:/1D3: F */
 	AF = af;
-	SET_SF16(sigma);
-	SET_PF16(sigma);
-	SET_ZF16(sigma);
+	SET_SZP16(sigma);
 
 	/* 1D0: Z 8 */
 	if (sigma != 0) {
@@ -842,3 +809,261 @@ void mc_mul16(I8086* cpu, uint16_t multiplicand, uint16_t multiplier, uint8_t is
 
 	/* 15F: | RNI */
 }
+
+/* Closed form MUL/DIV (I8086_ENABLE_FAST_MULDIV)
+	Same results, flags and divide errors as the microcode emulation without
+	stepping the CORX/CORD loops. PREIMUL/PREIDIV reduce the operands to their
+	magnitudes and F1 tracks the sign of the result, as in the microcode; a REP
+	prefix sets F1 and negates the result (8086 undocumented). */
+
+/* Flags of the CORD subtractions. The flags are only latched by a subtraction
+	whose partial remainder did not shift a bit out of tmpa; the last such step
+	is found from the partial remainders (dividend >> n) % divisor. */
+static void fast_cord8_flags(I8086* cpu, uint16_t dividend, uint8_t divisor) {
+	uint8_t x = (dividend >> 8) & 0xFF;
+	uint8_t sigma = 0;
+	uint8_t cf = 0;
+	uint8_t of = 0;
+	uint8_t af = 0;
+
+	for (int i = 8; i > 0; --i) {
+		uint8_t r = (uint8_t)((dividend >> (9 - i)) % divisor);
+		if (r < 0x80) {
+			x = (uint8_t)((r << 1) | ((dividend >> (8 - i)) & 1));
+			break;
+		}
+	}
+
+	cor_sub8(x, divisor, &sigma, &cf, &of, &af);
+	AF = af;
+	OF = of;
+	SET_SZP8(sigma);
+}
+static void fast_cord16_flags(I8086* cpu, uint32_t dividend, uint16_t divisor) {
+	uint16_t x = (dividend >> 16) & 0xFFFF;
+	uint16_t sigma = 0;
+	uint8_t cf = 0;
+	uint8_t of = 0;
+	uint8_t af = 0;
+
+	for (int i = 16; i > 0; --i) {
+		uint16_t r = (uint16_t)((dividend >> (17 - i)) % divisor);
+		if (r < 0x8000) {
+			x = (uint16_t)((r << 1) | ((dividend >> (16 - i)) & 1));
+			break;
+		}
+	}
+
+	cor_sub16(x, divisor, &sigma, &cf, &of, &af);
+	AF = af;
+	OF = of;
+	SET_SZP16(sigma);
+}
+
+void fast_div8(I8086* cpu, uint16_t dividend, uint8_t divisor, uint8_t is_signed, uint8_t* out_quotient, uint8_t* out_remainder) {
+	uint16_t n = dividend;
+	uint8_t d = divisor;
+	uint8_t quotient = 0;
+	uint8_t remainder = 0;
+	uint8_t f1 = (cpu->internal_flags & INTERNAL_FLAG_F1) >> 1;
+
+	/* PREIDIV */
+	if (is_signed) {
+		if (n & 0x8000) {
+			n = (uint16_t)(0 - n);
+			f1 = !f1;
+		}
+		if (d & 0x80) {
+			d = (uint8_t)(0 - d);
+			f1 = !f1;
+		}
+	}
+
+	/* CORD: the quotient does not fit; flags of the first subtraction */
+	if ((n >> 8) >= d) {
+		uint8_t sigma = 0;
+		uint8_t cf = 0;
+		uint8_t of = 0;
+		uint8_t af = 0;
+		cor_sub8((n >> 8) & 0xFF, d, &sigma, &cf, &of, &af);
+		AF = af;
+		CF = cf;
+		OF = of;
+		SET_SZP8(sigma);
+		i8086_int(cpu, INT_DBZ);
+		return;
+	}
+
+	quotient = (uint8_t)(n / d);
+	remainder = (uint8_t)(n % d);
+	fast_cord8_flags(cpu, n, d);
+	CF = !(quotient >> 7);
+
+	/* POSTIDIV */
+	if (is_signed) {
+		if (quotient & 0x80) {
+			i8086_int(cpu, INT_DBZ);
+			return;
+		}
+		if (dividend & 0x8000) {
+			remainder = (uint8_t)(0 - remainder);
+		}
+		if (f1) {
+			quotient = (uint8_t)(0 - quotient);
+		}
+		CF = 0;
+		OF = 0;
+	}
+
+	if (out_quotient) *out_quotient = quotient;
+	if (out_remainder) *out_remainder = remainder;
+}
+void fast_mul8(I8086* cpu, uint8_t multiplicand, uint8_t multiplier, uint8_t is_signed, uint8_t* product_lo, uint8_t* product_hi) {
+	uint8_t a = multiplicand;
+	uint8_t b = multiplier;
+	uint8_t sigma = 0;
+	uint8_t af = 0;
+	uint8_t f1 = (cpu->internal_flags & INTERNAL_FLAG_F1) >> 1;
+
+	/* PREIMUL */
+	if (is_signed) {
+		if (a & 0x80) {
+			a = (uint8_t)(0 - a);
+			f1 = !f1;
+		}
+		if (b & 0x80) {
+			b = (uint8_t)(0 - b);
+			f1 = !f1;
+		}
+	}
+
+	/* CORX, NEGATE */
+	uint16_t product = (uint16_t)(a * b);
+	if (f1) {
+		product = (uint16_t)(0 - product);
+	}
+	uint8_t lo = product & 0xFF;
+	uint8_t hi = (product >> 8) & 0xFF;
+
+	/* IMULCOF: tmpa + sign of tmpc */
+	if (is_signed) {
+		uint16_t tmp = hi + (lo >> 7);
+		af = ((hi ^ tmp) & 0x10) != 0;
+		sigma = tmp & 0xFF;
+	}
+	else {
+		sigma = hi;
+	}
+
+	AF = af;
+	SET_SZP8(sigma);
+	CF = sigma != 0;
+	OF = sigma != 0;
+
+	*product_lo = lo;
+	*product_hi = hi;
+}
+
+void fast_div16(I8086* cpu, uint32_t dividend, uint16_t divisor, uint8_t is_signed, uint16_t* out_quotient, uint16_t* out_remainder) {
+	uint32_t n = dividend;
+	uint16_t d = divisor;
+	uint16_t quotient = 0;
+	uint16_t remainder = 0;
+	uint8_t f1 = (cpu->internal_flags & INTERNAL_FLAG_F1) >> 1;
+
+	/* PREIDIV */
+	if (is_signed) {
+		if (n & 0x80000000) {
+			n = 0 - n;
+			f1 = !f1;
+		}
+		if (d & 0x8000) {
+			d = (uint16_t)(0 - d);
+			f1 = !f1;
+		}
+	}
+
+	/* CORD: the quotient does not fit; flags of the first subtraction */
+	if ((n >> 16) >= d) {
+		uint16_t sigma = 0;
+		uint8_t cf = 0;
+		uint8_t of = 0;
+		uint8_t af = 0;
+		cor_sub16((n >> 16) & 0xFFFF, d, &sigma, &cf, &of, &af);
+		AF = af;
+		CF = cf;
+		OF = of;
+		SET_SZP16(sigma);
+		i8086_int(cpu, INT_DBZ);
+		return;
+	}
+
+	quotient = (uint16_t)(n / d);
+	remainder = (uint16_t)(n % d);
+	fast_cord16_flags(cpu, n, d);
+	CF = !(quotient >> 15);
+
+	/* POSTIDIV */
+	if (is_signed) {
+		if (quotient & 0x8000) {
+			i8086_int(cpu, INT_DBZ);
+			return;
+		}
+		if (dividend & 0x80000000) {
+			remainder = (uint16_t)(0 - remainder);
+		}
+		if (f1) {
+			quotient = (uint16_t)(0 - quotient);
+		}
+		CF = 0;
+		OF = 0;
+	}
+
+	if (out_quotient) *out_quotient = quotient;
+	if (out_remainder) *out_remainder = remainder;
+}
+void fast_mul16(I8086* cpu, uint16_t multiplicand, uint16_t multiplier, uint8_t is_signed, uint16_t* product_lo, uint16_t* product_hi) {
+	uint16_t a = multiplicand;
+	uint16_t b = multiplier;
+	uint16_t sigma = 0;
+	uint8_t af = 0;
+	uint8_t f1 = (cpu->internal_flags & INTERNAL_FLAG_F1) >> 1;
+
+	/* PREIMUL */
+	if (is_signed) {
+		if (a & 0x8000) {
+			a = (uint16_t)(0 - a);
+			f1 = !f1;
+		}
+		if (b & 0x8000) {
+			b = (uint16_t)(0 - b);
+			f1 = !f1;
+		}
+	}
+
+	/* CORX, NEGATE */
+	uint32_t product = (uint32_t)a * b;
+	if (f1) {
+		product = 0 - product;
+	}
+	uint16_t lo = product & 0xFFFF;
+	uint16_t hi = (product >> 16) & 0xFFFF;
+
+	/* IMULCOF: tmpa + sign of tmpc */
+	if (is_signed) {
+		uint32_t tmp = (uint32_t)hi + (lo >> 15);
+		af = ((hi ^ tmp) & 0x10) != 0;
+		sigma = tmp & 0xFFFF;
+	}
+	else {
+		sigma = hi;
+	}
+
+	AF = af;
+	SET_SZP16(sigma);
+	CF = sigma != 0;
+	OF = sigma != 0;
+
+	*product_lo = lo;
+	*product_hi = hi;
+}
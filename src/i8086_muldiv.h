@@ -20,6 +20,14 @@ void mc_mul8(I8086* cpu, uint8_t multiplicand, uint8_t multiplier, uint8_t is_si
 void mc_div16(I8086* cpu, uint32_t dividend, uint16_t divisor, uint8_t is_signed, uint16_t* out_quotient, uint16_t* out_remainder);
 void mc_mul16(I8086* cpu, uint16_t multiplicand, uint16_t multiplier, uint8_t is_signed, uint16_t* product_lo, uint16_t* product_hi);
 
+/* Closed form; same results, flags and divide errors as the mc_ routines */
+
+void fast_div8(I8086* cpu, uint16_t dividend, uint8_t divisor, uint8_t is_signed, uint8_t* out_quotient, uint8_t* out_remainder);
+void fast_mul8(I8086* cpu, uint8_t multiplicand, uint8_t multiplier, uint8_t is_signed, uint8_t* product_lo, uint8_t* product_hi);
+
+void fast_div16(I8086* cpu, uint32_t dividend, uint16_t divisor, uint8_t is_signed, uint16_t* out_quotient, uint16_t* out_remainder);
+void fast_mul16(I8086* cpu, uint16_t multiplicand, uint16_t multiplier, uint8_t is_signed, uint16_t* product_lo, uint16_t* product_hi);
+
 #ifdef __cplusplus
 };
 #endif
@@ -0,0 +1,132 @@
+/* i8086_sched.c
+ * Thomas J. Armytage 2025 ( https://github.com/tommojphillips/ )
+ * Intel 8086 Event Scheduler
+ */
+
+/* Events live in a fixed table on the cpu. The scheduled ones are kept in a
+   binary min heap on their deadline so the next deadline is always event_heap[0].
+   i8086_run() runs to min(end of budget, next deadline) and calls
+   i8086_sched_update() when it gets there. */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "i8086.h"
+#include "i8086_sched.h"
+
+#ifdef I8086_ENABLE_SCHEDULER
+
+#define HEAP_LESS(a, b) (cpu->events[cpu->event_heap[a]].cycles < cpu->events[cpu->event_heap[b]].cycles)
+
+static void heap_swap(I8086* cpu, uint8_t a, uint8_t b) {
+	uint8_t tmp = cpu->event_heap[a];
+	cpu->event_heap[a] = cpu->event_heap[b];
+	cpu->event_heap[b] = tmp;
+	cpu->events[cpu->event_heap[a]].heap_index = a;
+	cpu->events[cpu->event_heap[b]].heap_index = b;
+}
+static void heap_up(I8086* cpu, uint8_t i) {
+	while (i > 0) {
+		uint8_t parent = (i - 1) / 2;
+		if (!HEAP_LESS(i, parent)) {
+			break;
+		}
+		heap_swap(cpu, i, parent);
+		i = parent;
+	}
+}
+static void heap_down(I8086* cpu, uint8_t i) {
+	for (;;) {
+		uint8_t left = i * 2 + 1;
+		uint8_t right = left + 1;
+		uint8_t min = i;
+		if (left < cpu->event_count && HEAP_LESS(left, min)) {
+			min = left;
+		}
+		if (right < cpu->event_count && HEAP_LESS(right, min)) {
+			min = right;
+		}
+		if (min == i) {
+			break;
+		}
+		heap_swap(cpu, i, min);
+		i = min;
+	}
+}
+static void heap_remove(I8086* cpu, uint8_t i) {
+	uint8_t id = cpu->event_heap[i];
+	cpu->event_count--;
+	if (i != cpu->event_count) {
+		// Move last entry to this slot
+		cpu->event_heap[i] = cpu->event_heap[cpu->event_count];
+		cpu->events[cpu->event_heap[i]].heap_index = i;
+		heap_down(cpu, i);
+		heap_up(cpu, i);
+	}
+	cpu->events[id].heap_index = I8086_EVENT_IDLE;
+}
+
+uint64_t i8086_sched_update(I8086* cpu, uint64_t end) {
+	while (cpu->event_count != 0) {
+		uint8_t id = cpu->event_heap[0];
+		I8086_EVENT* event = &cpu->events[id];
+		if (event->cycles > cpu->cycles) {
+			return event->cycles < end ? event->cycles : end;
+		}
+		heap_remove(cpu, 0);
+		event->cb(cpu, event->user, id);
+	}
+	return end;
+}
+
+int i8086_add_event(I8086* cpu, I8086_EVENT_CB cb, void* user) {
+	for (int i = 0; i < I8086_MAX_EVENTS; ++i) {
+		if (cpu->events[i].cb == NULL) {
+			cpu->events[i].cycles = 0;
+			cpu->events[i].cb = cb;
+			cpu->events[i].user = user;
+			cpu->events[i].heap_index = I8086_EVENT_IDLE;
+			return i;
+		}
+	}
+	// events are full.
+	return -1;
+}
+void i8086_remove_event(I8086* cpu, int id) {
+	if (id < 0 || id >= I8086_MAX_EVENTS) {
+		return;
+	}
+	i8086_cancel_event(cpu, id);
+	cpu->events[id].cb = NULL;
+	cpu->events[id].user = NULL;
+}
+void i8086_schedule_event(I8086* cpu, int id, uint64_t cycles) {
+	if (id < 0 || id >= I8086_MAX_EVENTS || cpu->events[id].cb == NULL) {
+		return;
+	}
+	I8086_EVENT* event = &cpu->events[id];
+	event->cycles = cycles;
+	if (event->heap_index == I8086_EVENT_IDLE) {
+		event->heap_index = cpu->event_count;
+		cpu->event_heap[cpu->event_count] = (uint8_t)id;
+		cpu->event_count++;
+		heap_up(cpu, event->heap_index);
+	}
+	else {
+		heap_down(cpu, event->heap_index);
+		heap_up(cpu, event->heap_index);
+	}
+
+	/* a run in progress stops at the new deadline; run_end is 0 when single stepping */
+	if (cpu->run_end != 0 && cycles < cpu->run_end) {
+		cpu->run_end = cycles;
+	}
+}
+void i8086_cancel_event(I8086* cpu, int id) {
+	if (id < 0 || id >= I8086_MAX_EVENTS || cpu->events[id].heap_index == I8086_EVENT_IDLE) {
+		return;
+	}
+	heap_remove(cpu, cpu->events[id].heap_index);
+}
+
+#endif
@@ -0,0 +1,27 @@
+/* i8086_sched.h
+ * Thomas J. Armytage 2025 ( https://github.com/tommojphillips/ )
+ * Intel 8086 Event Scheduler
+ */
+
+#ifndef I8086_SCHED_H
+#define I8086_SCHED_H
+
+#include <stdint.h>
+
+#include "i8086.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Call the events that are due at cpu->cycles
+	cpu: the cpu instance
+	end: the end of the run
+	return: the cycle the run must stop at; the next deadline or end, whichever is first */
+uint64_t i8086_sched_update(I8086* cpu, uint64_t end);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif
@@ -0,0 +1,260 @@
+/* async_interrupts_test.c
+ * Thomas J. Armytage 2025 ( https://github.com/tommojphillips/ )
+ * Intel 8086 Async Interrupts Test
+ */
+
+/* Checks the interrupts posted through i8086_async_intr(), i8086_async_set_intr_line()
+   and i8086_async_nmi() (I8086_ENABLE_ASYNC_INTERRUPTS).
+	- rep latency: an interrupt posted while a long rep stosb runs in bulk is taken
+	  at the next iteration, not when the rep ends. The handler records CX.
+	- stress: device threads post edge requests, raise the INTR line and raise NMI
+	  while the cpu thread runs rep stosw loops. Each device waits for its request
+	  to be acknowledged before it posts the next; every request must be taken.
+	  Build with -fsanitize=thread to check the posting path for data races.
+
+   Build from the repository root:
+	gcc -O2 -Isrc -DI8086_ENABLE_ASYNC_INTERRUPTS tests/async_interrupts_test.c src/i8086.c
+		src/i8086_alu.c src/i8086_modrm.c src/i8086_muldiv.c src/sign_extend.c -lpthread
+		-o async_interrupts_test
+	./async_interrupts_test [posts per device]
+   Add -g -fsanitize=thread for the race check. */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "i8086.h"
+
+#ifndef I8086_ENABLE_ASYNC_INTERRUPTS
+#error "build with I8086_ENABLE_ASYNC_INTERRUPTS"
+#endif
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+typedef HANDLE THREAD;
+#define THREAD_FUNC DWORD WINAPI
+#define THREAD_RETURN 0
+#define LOAD(p) _InterlockedOr((volatile long*)(p), 0)
+#define STORE(p, v) _InterlockedExchange((volatile long*)(p), (long)(v))
+#define YIELD() SwitchToThread()
+#else
+#include <pthread.h>
+#include <sched.h>
+typedef pthread_t THREAD;
+#define THREAD_FUNC void*
+#define THREAD_RETURN NULL
+#define LOAD(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define STORE(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define YIELD() sched_yield()
+#endif
+
+#define DEVICES     3
+#define DEVICE_INTR 0 // i8086_async_intr(0x20)
+#define DEVICE_LINE 1 // i8086_async_set_intr_line(1); vector 0x21 from inta
+#define DEVICE_NMI  2 // i8086_async_nmi()
+
+static uint8_t mem[0x100000];
+static I8086 cpu;
+
+/* rep latency: the write that posts the interrupt */
+static int post_on_write;
+static int es_writes;
+
+/* stress: the number of the last request posted / acknowledged per device */
+static long posted[DEVICES];
+static long acked[DEVICES];
+static int posts;
+
+static uint8_t read_mem_byte(I8086* c, void* user, uint20_t address) {
+	(void)c;
+	(void)user;
+	return mem[address & 0xFFFFF];
+}
+static void write_mem_byte(I8086* c, void* user, uint20_t address, uint8_t value) {
+	(void)user;
+	mem[address & 0xFFFFF] = value;
+	if (post_on_write != 0 && address >= 0x50000 && address < 0x60000 && ++es_writes == post_on_write) {
+		i8086_async_intr(c, 0x20);
+	}
+}
+static uint8_t read_io_byte(I8086* c, void* user, uint16_t port) {
+	(void)c;
+	(void)user;
+	(void)port;
+	return 0xFF;
+}
+static void write_io_byte(I8086* c, void* user, uint16_t port, uint8_t value) {
+	(void)c;
+	(void)user;
+	(void)port;
+	(void)value;
+}
+
+static void set_vector(uint8_t type, uint16_t offset) {
+	mem[type * 4 + 0] = (uint8_t)offset;
+	mem[type * 4 + 1] = (uint8_t)(offset >> 8);
+	mem[type * 4 + 2] = 0x00;
+	mem[type * 4 + 3] = 0x30;
+}
+
+/* code at 1000:0000, handlers at 3000:xxxx, stack at 4000:0100, ES at 5000:0000 */
+static void setup(const uint8_t* code, uint32_t size) {
+	memset(mem, 0, sizeof(mem));
+	memcpy(mem + 0x10000, code, size);
+	i8086_init(&cpu);
+	cpu.funcs.read_mem_byte = read_mem_byte;
+	cpu.funcs.write_mem_byte = write_mem_byte;
+	cpu.funcs.read_io_byte = read_io_byte;
+	cpu.funcs.write_io_byte = write_io_byte;
+	i8086_reset(&cpu);
+	i8086_set_segment(&cpu, SEG_CS, 0x1000);
+	i8086_set_segment(&cpu, SEG_DS, 0x0000);
+	i8086_set_segment(&cpu, SEG_ES, 0x5000);
+	i8086_set_segment(&cpu, SEG_SS, 0x4000);
+	cpu.registers[REG_SP].r16 = 0x0100;
+	cpu.ip = 0;
+}
+
+static int test_rep_latency(void) {
+	static const uint8_t code[] = {
+		0xFB,             // sti
+		0xB9, 0xFF, 0xFF, // mov cx, FFFFh
+		0x31, 0xFF,       // xor di, di
+		0xF3, 0xAA,       // rep stosb
+		0xF4,             // hlt
+	};
+	static const uint8_t handler[] = {
+		0x89, 0x0E, 0x00, 0x05, // mov [0500h], cx
+		0xCF,                   // iret
+	};
+	setup(code, sizeof(code));
+	memcpy(mem + 0x30000, handler, sizeof(handler));
+	set_vector(0x20, 0x0000);
+	post_on_write = 16;
+	es_writes = 0;
+	i8086_run(&cpu, 2000000);
+	post_on_write = 0;
+
+	uint16_t cx = mem[0x500] | (mem[0x501] << 8);
+	if (cx < 0xFF00 || cpu.registers[REG_CX].r16 != 0 || !cpu.halted) {
+		printf("rep latency: handler saw CX %04X after %d stores; CX %04X halted %d\n",
+			cx, es_writes, cpu.registers[REG_CX].r16, cpu.halted);
+		return 0;
+	}
+	return 1;
+}
+
+static THREAD_FUNC device_main(void* arg) {
+	int d = (int)(intptr_t)arg;
+	for (long i = 1; i <= posts; ++i) {
+		STORE(&posted[d], i);
+		switch (d) {
+			case DEVICE_INTR:
+				i8086_async_intr(&cpu, 0x20);
+				break;
+			case DEVICE_LINE:
+				i8086_async_set_intr_line(&cpu, 1);
+				break;
+			case DEVICE_NMI:
+				i8086_async_nmi(&cpu);
+				break;
+		}
+		while (LOAD(&acked[d]) != i) {
+			YIELD();
+		}
+	}
+	return THREAD_RETURN;
+}
+
+/* Acknowledge one outstanding device per INTA. Runs on the cpu thread */
+static uint8_t inta(I8086* c, void* user) {
+	(void)user;
+	long p = LOAD(&posted[DEVICE_INTR]);
+	if (LOAD(&acked[DEVICE_INTR]) != p) {
+		STORE(&acked[DEVICE_INTR], p);
+		return 0x20;
+	}
+	p = LOAD(&posted[DEVICE_LINE]);
+	i8086_set_intr_line(c, 0);
+	if (LOAD(&acked[DEVICE_LINE]) != p) {
+		STORE(&acked[DEVICE_LINE], p);
+		return 0x21;
+	}
+	return 0x22; // spurious; a request acknowledged before its post arrived
+}
+
+static int done(void) {
+	for (int d = 0; d < DEVICES; ++d) {
+		if (LOAD(&acked[d]) != posts) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static int test_stress(void) {
+	static const uint8_t code[] = {
+		0xFB,             // sti
+		0xB9, 0x00, 0x04, // mov cx, 0400h
+		0x31, 0xFF,       // xor di, di
+		0xF3, 0xAB,       // rep stosw
+		0xEB, 0xF6,       // jmp 0
+	};
+	static const uint8_t handlers[] = {
+		0xCF,                               // 3000:0000 iret
+		0xFF, 0x06, 0x00, 0x05, 0xCF,       // 3000:0001 inc word [0500h]; iret
+	};
+	setup(code, sizeof(code));
+	memcpy(mem + 0x30000, handlers, sizeof(handlers));
+	set_vector(0x20, 0x0000);
+	set_vector(0x21, 0x0000);
+	set_vector(0x22, 0x0000);
+	set_vector(0x02, 0x0001);
+	cpu.funcs.inta = inta;
+
+	THREAD threads[DEVICES];
+	for (int d = 0; d < DEVICES; ++d) {
+#ifdef _WIN32
+		threads[d] = CreateThread(NULL, 0, device_main, (void*)(intptr_t)d, 0, NULL);
+#else
+		pthread_create(&threads[d], NULL, device_main, (void*)(intptr_t)d);
+#endif
+	}
+
+	/* the NMI handler counts its runs; each new run acknowledges the posted NMI */
+	uint16_t nmis = 0;
+	while (!done()) {
+		i8086_run(&cpu, 1000);
+		uint16_t n = mem[0x500] | (mem[0x501] << 8);
+		if (n != nmis) {
+			nmis = n;
+			STORE(&acked[DEVICE_NMI], LOAD(&posted[DEVICE_NMI]));
+		}
+		YIELD();
+	}
+
+	for (int d = 0; d < DEVICES; ++d) {
+#ifdef _WIN32
+		WaitForSingleObject(threads[d], INFINITE);
+		CloseHandle(threads[d]);
+#else
+		pthread_join(threads[d], NULL);
+#endif
+	}
+	if (nmis != (uint16_t)posts) {
+		printf("stress: %d NMIs posted, the handler ran %u times\n", posts, nmis);
+		return 0;
+	}
+	return 1;
+}
+
+int main(int argc, char** argv) {
+	posts = argc > 1 ? atoi(argv[1]) : 5000;
+	if (!test_rep_latency() || !test_stress()) {
+		return 1;
+	}
+	printf("rep latency and stress (%d posts x %d devices) pass\n", posts, DEVICES);
+	return 0;
+}
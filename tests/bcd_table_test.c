@@ -0,0 +1,207 @@
+/* bcd_table_test.c
+ * Thomas J. Armytage 2025 ( https://github.com/tommojphillips/ )
+ * Intel 8086 BCD Adjust Table Test
+ */
+
+/* Checks the table driven DAA/DAS/AAA/AAS (alu_daa .. alu_aas) against the
+   branchy reference below, which computes the adjust the way the ALU used to.
+   Both run from the same psw; AL, AH and the whole psw word must match.
+	- every AL, every AH, AF and CF clear/set, over several psw images
+
+   Build from the repository root:
+	gcc -O2 -Isrc tests/bcd_table_test.c src/i8086_alu.c src/i8086_muldiv.c -o bcd_table_test
+	./bcd_table_test */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "i8086.h"
+#include "i8086_alu.h"
+#include "i8086_alu_ops.h"
+
+/* The ALU raises the divide error through i8086_int(); not reached here */
+void i8086_int(I8086* cpu, uint8_t type) {
+	(void)cpu;
+	(void)type;
+}
+
+/* Reference */
+
+static void ref_daa(I8086* cpu, uint8_t* x1) {
+	SYNC_FLAGS();
+	uint8_t correction = 0;
+	uint8_t af = AF;
+	uint8_t cf = CF;
+
+	uint16_t check_val = 0;
+	if (af) {
+		check_val = 0x9F;
+	}
+	else {
+		check_val = 0x99;
+	}
+
+	if ((*x1 & 0x0F) > 9 || af) {
+		correction |= 0x06;
+		af = 1;
+	}
+	else {
+		af = 0;
+	}
+
+	if (*x1 > check_val || cf) {
+		correction |= 0x60;
+		cf = 1;
+	}
+	else {
+		cf = 0;
+	}
+
+	alu_add8(cpu, x1, correction);
+	SYNC_FLAGS();
+
+	AF = af;
+	CF = cf;
+}
+static void ref_das(I8086* cpu, uint8_t* x1) {
+	SYNC_FLAGS();
+	uint8_t correction = 0;
+	uint8_t af = AF;
+	uint8_t cf = CF;
+
+	uint16_t check_val = 0;
+	if (af) {
+		check_val = 0x9F;
+	}
+	else {
+		check_val = 0x99;
+	}
+
+	if ((*x1 & 0x0F) > 9 || af) {
+		correction |= 6;
+		af = 1;
+	}
+
+	if (*x1 > check_val || cf) {
+		correction |= 0x60;
+		cf = 1;
+	}
+
+	alu_sub8(cpu, x1, correction);
+	SYNC_FLAGS();
+
+	AF = af;
+	CF = cf;
+}
+static void ref_aaa(I8086* cpu, uint8_t* l, uint8_t* h) {
+	SYNC_FLAGS();
+
+	SF = *l >= 0x7A && *l <= 0xF9;
+	OF = *l >= 0x7A && *l <= 0x7F;
+
+	if ((*l & 0x0F) > 9 || AF) {
+		*l = (*l + 6);
+		*h += 1;
+		AF = 1;
+		CF = 1;
+	}
+	else {
+		AF = 0;
+		CF = 0;
+	}
+
+	SET_ZF8(*l);
+	SET_PF8(*l);
+
+	*l &= 0x0F;
+}
+static void ref_aas(I8086* cpu, uint8_t* l, uint8_t* h) {
+	SYNC_FLAGS();
+
+	SF = (!AF && *l > 0x7F) || (AF && (*l <= 0x05 || *l >= 0x86));
+	OF = (AF && *l > 0x7F && *l <= 0x85);
+
+	if ((*l & 0x0F) > 9 || AF) {
+		*l -= 6;
+		*h -= 1;
+		AF = 1;
+		CF = 1;
+	}
+	else {
+		AF = 0;
+		CF = 0;
+	}
+
+	SET_ZF8(*l);
+	SET_PF8(*l);
+
+	*l &= 0x0F;
+}
+
+/* psw images; the status flags all clear / all set, and the control flags set */
+static const uint16_t psws[] = { 0xF002, 0xFFD7, 0xF702, 0xF8C6 };
+#define PSW_COUNT (sizeof(psws) / sizeof(psws[0]))
+
+static I8086 ref_cpu;
+static I8086 alu_cpu;
+static uint64_t cases;
+
+static const char* const names[4] = { "daa", "das", "aaa", "aas" };
+
+static int check(int op, uint16_t psw, uint8_t al, uint8_t ah) {
+	uint8_t ref_l = al;
+	uint8_t ref_h = ah;
+	uint8_t alu_l = al;
+	uint8_t alu_h = ah;
+	ref_cpu.status.word = psw;
+	alu_cpu.status.word = psw;
+	switch (op) {
+		case 0:
+			ref_daa(&ref_cpu, &ref_l);
+			alu_daa(&alu_cpu, &alu_l);
+			break;
+		case 1:
+			ref_das(&ref_cpu, &ref_l);
+			alu_das(&alu_cpu, &alu_l);
+			break;
+		case 2:
+			ref_aaa(&ref_cpu, &ref_l, &ref_h);
+			alu_aaa(&alu_cpu, &alu_l, &alu_h);
+			break;
+		case 3:
+			ref_aas(&ref_cpu, &ref_l, &ref_h);
+			alu_aas(&alu_cpu, &alu_l, &alu_h);
+			break;
+	}
+	cases++;
+	if (ref_l != alu_l || ref_h != alu_h || ref_cpu.status.word != alu_cpu.status.word) {
+		printf("%s al %02X ah %02X psw %04X: expected %02X %02X psw %04X, got %02X %02X psw %04X\n",
+			names[op], al, ah, psw, ref_h, ref_l, ref_cpu.status.word, alu_h, alu_l, alu_cpu.status.word);
+		return 0;
+	}
+	return 1;
+}
+
+int main(void) {
+	memset(&ref_cpu, 0, sizeof(ref_cpu));
+	memset(&alu_cpu, 0, sizeof(alu_cpu));
+
+	for (int op = 0; op < 4; ++op) {
+		for (size_t p = 0; p < PSW_COUNT; ++p) {
+			for (uint16_t flags = 0; flags < 4; ++flags) {
+				/* AF and CF */
+				uint16_t psw = (psws[p] & ~0x0011) | ((flags & 2) << 3) | (flags & 1);
+				for (uint32_t al = 0; al < 0x100; ++al) {
+					for (uint32_t ah = 0; ah < 0x100; ++ah) {
+						if (!check(op, psw, (uint8_t)al, (uint8_t)ah)) {
+							return 1;
+						}
+					}
+				}
+			}
+		}
+	}
+	printf("%llu cases match\n", (unsigned long long)cases);
+	return 0;
+}
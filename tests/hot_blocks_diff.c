@@ -0,0 +1,206 @@
+/* hot_blocks_diff.c
+ * Thomas J. Armytage 2025 ( https://github.com/tommojphillips/ )
+ * Intel 8086 Hot Blocks Differential Test
+ */
+
+/* Two cpus run the same random code in lock step. One has a decode cache with
+   hot blocks (I8086_ENABLE_HOT_BLOCKS), the other has no cache and runs the
+   plain interpreter. After every instruction the registers, flags, cycles and
+   io writes must match; the memory must match at the end. The start of the
+   code is re-entered every few thousand instructions so entries get hot.
+
+   Build from the repository root:
+	gcc -O2 -Isrc -DI8086_ENABLE_DECODE_CACHE -DI8086_ENABLE_HOT_BLOCKS tests/hot_blocks_diff.c
+		src/i8086.c src/i8086_alu.c src/i8086_cache.c src/i8086_modrm.c src/i8086_muldiv.c
+		src/sign_extend.c -o hot_blocks_diff
+	./hot_blocks_diff [seeds] [steps] */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "i8086.h"
+#include "i8086_cache.h"
+
+#if !defined(I8086_ENABLE_DECODE_CACHE) || !defined(I8086_ENABLE_HOT_BLOCKS)
+#error "build with I8086_ENABLE_DECODE_CACHE and I8086_ENABLE_HOT_BLOCKS"
+#endif
+
+#define RESTART 4096 // instructions between restarts at the start of the code
+
+typedef struct BUS {
+	uint8_t mem[0x100000];
+	uint64_t io_hash; // hash of every io write
+} BUS;
+
+static BUS bus_hot;
+static BUS bus_ref;
+static I8086 cpu_hot;
+static I8086 cpu_ref;
+static I8086_DECODE_CACHE cache;
+
+static uint64_t rng;
+static uint32_t rnd(void) {
+	rng ^= rng << 13;
+	rng ^= rng >> 7;
+	rng ^= rng << 17;
+	return (uint32_t)rng;
+}
+
+static uint8_t read_mem_byte(I8086* cpu, void* user, uint20_t address) {
+	(void)cpu;
+	return ((BUS*)user)->mem[address & 0xFFFFF];
+}
+static void write_mem_byte(I8086* cpu, void* user, uint20_t address, uint8_t value) {
+	(void)cpu;
+	((BUS*)user)->mem[address & 0xFFFFF] = value;
+}
+static uint8_t read_io_byte(I8086* cpu, void* user, uint16_t port) {
+	(void)cpu;
+	(void)user;
+	return (uint8_t)(port * 37 + 11);
+}
+static void write_io_byte(I8086* cpu, void* user, uint16_t port, uint8_t value) {
+	(void)cpu;
+	BUS* bus = (BUS*)user;
+	bus->io_hash = (bus->io_hash ^ ((uint32_t)port << 8 | value)) * 1099511628211ULL;
+}
+
+static void setup(I8086* cpu, BUS* bus) {
+	i8086_init(cpu);
+	cpu->funcs.user = bus;
+	cpu->funcs.read_mem_byte = read_mem_byte;
+	cpu->funcs.write_mem_byte = write_mem_byte;
+	cpu->funcs.read_io_byte = read_io_byte;
+	cpu->funcs.write_io_byte = write_io_byte;
+	bus->io_hash = 1469598103934665603ULL;
+}
+
+static void set_state(I8086* cpu, const uint16_t* regs, const uint16_t* segs, uint16_t ip, uint16_t flags) {
+	for (int i = 0; i < 8; ++i) {
+		cpu->registers[i].r16 = regs[i];
+	}
+	for (int i = 0; i < 4; ++i) {
+		i8086_set_segment(cpu, i, segs[i]);
+	}
+	cpu->ip = ip;
+	cpu->status.word = flags;
+	cpu->halted = 0;
+}
+
+static int same_state(void) {
+	for (int i = 0; i < 8; ++i) {
+		if (cpu_hot.registers[i].r16 != cpu_ref.registers[i].r16) {
+			return 0;
+		}
+	}
+	for (int i = 0; i < 4; ++i) {
+		if (cpu_hot.segments[i] != cpu_ref.segments[i]) {
+			return 0;
+		}
+	}
+	return cpu_hot.ip == cpu_ref.ip && cpu_hot.status.word == cpu_ref.status.word &&
+		cpu_hot.cycles == cpu_ref.cycles && bus_hot.io_hash == bus_ref.io_hash;
+}
+
+static void print_state(const char* name, I8086* cpu) {
+	printf("  %s: AX=%04X CX=%04X DX=%04X BX=%04X SP=%04X BP=%04X SI=%04X DI=%04X ES=%04X CS=%04X SS=%04X DS=%04X IP=%04X F=%04X cycles=%llu\n",
+		name, cpu->registers[0].r16, cpu->registers[1].r16, cpu->registers[2].r16, cpu->registers[3].r16,
+		cpu->registers[4].r16, cpu->registers[5].r16, cpu->registers[6].r16, cpu->registers[7].r16,
+		cpu->segments[0], cpu->segments[1], cpu->segments[2], cpu->segments[3], cpu->ip, cpu->status.word,
+		(unsigned long long)cpu->cycles);
+}
+
+static int run_seed(uint64_t seed, int steps, uint32_t* hot_entries) {
+	rng = seed * 2654435761ULL + 1;
+
+	/* random code biased towards rep string ops, shifts and short loops */
+	for (uint32_t i = 0; i < 0x100000; ++i) {
+		uint32_t r = rnd();
+		uint8_t b = r & 0xFF;
+		switch ((r >> 8) & 31) {
+			case 0: b = 0xF3; break;                       // rep
+			case 1: b = 0xA4 + ((r >> 16) & 0xB); break;   // string op
+			case 2: b = 0xD0 + ((r >> 16) & 3); break;     // shift/rotate
+			case 3: b = 0xE2; break;                       // loop
+			case 4: b = 0x80 + ((r >> 16) & 3); break;     // group 1
+			case 5: b = 0xFE + ((r >> 16) & 1); break;     // group 4/5
+		}
+		if (b == 0xF4) {
+			b = 0x90; // no hlt
+		}
+		bus_hot.mem[i] = b;
+	}
+	memcpy(bus_ref.mem, bus_hot.mem, sizeof(bus_ref.mem));
+
+	setup(&cpu_hot, &bus_hot);
+	setup(&cpu_ref, &bus_ref);
+	i8086_set_decode_cache(&cpu_hot, &cache);
+	i8086_reset(&cpu_hot);
+	i8086_reset(&cpu_ref);
+
+	uint16_t regs[8];
+	uint16_t segs[4];
+	for (int i = 0; i < 8; ++i) {
+		regs[i] = (uint16_t)rnd();
+	}
+	for (int i = 0; i < 4; ++i) {
+		segs[i] = (uint16_t)rnd();
+	}
+	uint16_t ip = (uint16_t)rnd();
+	uint16_t flags = (uint16_t)((rnd() & 0x0CD5) | 0xF002); // TF clear
+
+	for (int s = 0; s < steps; ++s) {
+		if (s % RESTART == 0) {
+			set_state(&cpu_hot, regs, segs, ip, flags);
+			set_state(&cpu_ref, regs, segs, ip, flags);
+		}
+		uint32_t r = rnd();
+		if ((r & 255) == 0) {
+			i8086_intr(&cpu_hot, (r >> 8) & 0xFF);
+			i8086_intr(&cpu_ref, (r >> 8) & 0xFF);
+		}
+		if ((r & 1023) == 1) {
+			i8086_nmi(&cpu_hot);
+			i8086_nmi(&cpu_ref);
+		}
+		int a = i8086_execute(&cpu_hot);
+		int b = i8086_execute(&cpu_ref);
+		if (a != b || !same_state()) {
+			printf("seed %llu: mismatch after %d instructions\n", (unsigned long long)seed, s + 1);
+			print_state("hot", &cpu_hot);
+			print_state("ref", &cpu_ref);
+			return 0;
+		}
+	}
+	if (memcmp(bus_hot.mem, bus_ref.mem, sizeof(bus_hot.mem)) != 0) {
+		printf("seed %llu: memory mismatch\n", (unsigned long long)seed);
+		return 0;
+	}
+
+	for (uint32_t i = 0; i < I8086_CACHE_ENTRIES; ++i) {
+		if (cache.entries[i].address != I8086_CACHE_INVALID && cache.entries[i].handler != NULL) {
+			*hot_entries += 1;
+		}
+	}
+	return 1;
+}
+
+int main(int argc, char** argv) {
+	int seeds = argc > 1 ? atoi(argv[1]) : 20;
+	int steps = argc > 2 ? atoi(argv[2]) : 200000;
+	uint32_t hot_entries = 0;
+
+	for (int seed = 1; seed <= seeds; ++seed) {
+		if (!run_seed(seed, steps, &hot_entries)) {
+			return 1;
+		}
+	}
+	if (hot_entries == 0) {
+		printf("no hot entries were executed\n");
+		return 1;
+	}
+	printf("%d seeds x %d instructions match; %u hot entries\n", seeds, steps, hot_entries);
+	return 0;
+}
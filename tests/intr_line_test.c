@@ -0,0 +1,178 @@
+/* intr_line_test.c
+ * Thomas J. Armytage 2025 ( https://github.com/tommojphillips/ )
+ * Intel 8086 INTR Line Test
+ */
+
+/* Checks the two ways of driving INTR and how they mix.
+	- level: an interrupt controller model holds the line high and presents queued
+	  vectors one by one from inta; every vector is taken, in order, and the line is
+	  low afterwards
+	- edge: a request from i8086_intr() is taken once
+	- mixed: lowering the line with i8086_set_intr_line(cpu, 0) while IF is clear
+	  keeps a request latched by i8086_intr(); it is taken once IF is set
+
+   Each vector 20h-27h has a handler that counts its calls in a byte at 0000:0100+v.
+
+   Build from the repository root:
+	gcc -O2 -Isrc tests/intr_line_test.c src/i8086.c src/i8086_alu.c src/i8086_modrm.c
+		src/i8086_muldiv.c src/sign_extend.c -o intr_line_test
+	./intr_line_test */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "i8086.h"
+
+#define STI_LOOP 0x0000 // 1000:0000 sti; jmp $
+#define CLI_LOOP 0x0010 // 1000:0010 cli; jmp $
+
+static uint8_t mem[0x100000];
+
+/* interrupt controller model; vectors waiting for inta */
+static uint8_t queue[64];
+static int queue_head;
+static int queue_tail;
+
+static uint8_t read_mem_byte(I8086* cpu, void* user, uint20_t address) {
+	(void)cpu;
+	(void)user;
+	return mem[address & 0xFFFFF];
+}
+static void write_mem_byte(I8086* cpu, void* user, uint20_t address, uint8_t value) {
+	(void)cpu;
+	(void)user;
+	mem[address & 0xFFFFF] = value;
+}
+static uint8_t read_io_byte(I8086* cpu, void* user, uint16_t port) {
+	(void)cpu;
+	(void)user;
+	(void)port;
+	return 0xFF;
+}
+static void write_io_byte(I8086* cpu, void* user, uint16_t port, uint8_t value) {
+	(void)cpu;
+	(void)user;
+	(void)port;
+	(void)value;
+}
+
+/* present the next vector; lower the line when the queue is empty */
+static uint8_t inta(I8086* cpu, void* user) {
+	(void)user;
+	uint8_t type = queue[queue_head++];
+	if (queue_head == queue_tail) {
+		i8086_set_intr_line(cpu, 0);
+	}
+	return type;
+}
+
+static int count(uint8_t type) {
+	return mem[0x100 + type];
+}
+
+static void setup(I8086* cpu, uint16_t ip) {
+	memset(mem, 0, sizeof(mem));
+	/* handler for vector v at 2000:v*8; inc byte [0100+v]; iret */
+	for (int v = 0x20; v < 0x28; ++v) {
+		uint8_t* handler = mem + 0x20000 + v * 8;
+		handler[0] = 0xFE;
+		handler[1] = 0x06;
+		handler[2] = (uint8_t)v;
+		handler[3] = 0x01;
+		handler[4] = 0xCF;
+		mem[v * 4 + 0] = (uint8_t)(v * 8);
+		mem[v * 4 + 1] = (uint8_t)((v * 8) >> 8);
+		mem[v * 4 + 2] = 0x00;
+		mem[v * 4 + 3] = 0x20;
+	}
+	mem[0x10000 + STI_LOOP + 0] = 0xFB;
+	mem[0x10000 + STI_LOOP + 1] = 0xEB;
+	mem[0x10000 + STI_LOOP + 2] = 0xFE;
+	mem[0x10000 + CLI_LOOP + 0] = 0xFA;
+	mem[0x10000 + CLI_LOOP + 1] = 0xEB;
+	mem[0x10000 + CLI_LOOP + 2] = 0xFE;
+
+	i8086_init(cpu);
+	cpu->funcs.read_mem_byte = read_mem_byte;
+	cpu->funcs.write_mem_byte = write_mem_byte;
+	cpu->funcs.read_io_byte = read_io_byte;
+	cpu->funcs.write_io_byte = write_io_byte;
+	i8086_reset(cpu);
+	i8086_set_segment(cpu, SEG_CS, 0x1000);
+	i8086_set_segment(cpu, SEG_DS, 0x0000);
+	i8086_set_segment(cpu, SEG_SS, 0x3000);
+	cpu->registers[REG_SP].r16 = 0x0100;
+	cpu->ip = ip;
+	queue_head = 0;
+	queue_tail = 0;
+}
+
+static int test_level(void) {
+	I8086 cpu;
+	setup(&cpu, STI_LOOP);
+	cpu.funcs.inta = inta;
+	for (int burst = 0; burst < 100; ++burst) {
+		for (int k = 0; k < 5; ++k) {
+			queue[queue_tail++] = (uint8_t)(0x20 + ((burst + k) & 7));
+		}
+		i8086_set_intr_line(&cpu, 1);
+		i8086_run(&cpu, 2000);
+		if (queue_head != queue_tail) {
+			printf("level: burst %d: %d of %d vectors taken\n", burst, queue_head, queue_tail);
+			return 0;
+		}
+		queue_head = 0;
+		queue_tail = 0;
+	}
+	int total = 0;
+	for (int v = 0x20; v < 0x28; ++v) {
+		total += count((uint8_t)v);
+	}
+	if (total != 500 || cpu.intr) {
+		printf("level: %d of 500 taken, INTR %d\n", total, cpu.intr);
+		return 0;
+	}
+	return 1;
+}
+
+static int test_edge(void) {
+	I8086 cpu;
+	setup(&cpu, STI_LOOP);
+	i8086_intr(&cpu, 0x21);
+	i8086_run(&cpu, 2000);
+	if (count(0x21) != 1 || cpu.intr) {
+		printf("edge: taken %d times, INTR %d\n", count(0x21), cpu.intr);
+		return 0;
+	}
+	return 1;
+}
+
+static int test_mixed(void) {
+	I8086 cpu;
+	setup(&cpu, CLI_LOOP);
+	i8086_run(&cpu, 100);
+	i8086_intr(&cpu, 0x22);
+	i8086_set_intr_line(&cpu, 1);
+	i8086_set_intr_line(&cpu, 0);
+	i8086_run(&cpu, 2000);
+	if (count(0x22) != 0 || !cpu.intr) {
+		printf("mixed: taken %d times with IF clear, INTR %d\n", count(0x22), cpu.intr);
+		return 0;
+	}
+	cpu.ip = STI_LOOP;
+	i8086_run(&cpu, 2000);
+	if (count(0x22) != 1 || cpu.intr) {
+		printf("mixed: taken %d times after sti, INTR %d\n", count(0x22), cpu.intr);
+		return 0;
+	}
+	return 1;
+}
+
+int main(void) {
+	if (!test_level() || !test_edge() || !test_mixed()) {
+		return 1;
+	}
+	printf("level, edge and mixed INTR pass\n");
+	return 0;
+}
@@ -0,0 +1,439 @@
+/* muldiv_verify.c
+ * Thomas J. Armytage 2025 ( https://github.com/tommojphillips/ )
+ * Intel 8086 MUL/DIV Verifier
+ */
+
+/* Checks the closed form MUL/DIV routines (fast_*) against the microcode
+   emulation (mc_*) bit for bit. See MulDiv_Verification.md.
+
+   Every case runs through both routines from the same random psw. The two runs
+   must agree on the result registers, the whole psw word, the cycle count and
+   whether the divide error interrupt was raised. On a divide error the outputs
+   must be left untouched.
+	- 8-bit DIV/IDIV: every dividend, every divisor, signed and unsigned, with and without F1
+	- 8-bit MUL/IMUL: every multiplicand and multiplier, signed and unsigned, with and without F1
+	- 16-bit MUL/IMUL/DIV/IDIV: a stratified random set (see case16())
+
+   The work is split into tasks and run on a work stealing pool, one worker per
+   core. Each worker owns a range of task indices and takes tasks from the
+   front; a worker that runs dry steals the back half of another worker's range.
+   Both ends of a range live in one 64-bit word, so a take or a steal is a single
+   compare exchange.
+
+   Build from the repository root:
+	gcc -O2 -Isrc tests/muldiv_verify.c src/i8086_muldiv.c src/i8086_alu.c -lpthread -o muldiv_verify
+	./muldiv_verify [16-bit cases, millions] [threads] */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "i8086.h"
+#include "i8086_muldiv.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <intrin.h>
+typedef HANDLE THREAD;
+#define THREAD_FUNC DWORD WINAPI
+#define THREAD_RETURN 0
+#define CAS64(p, expected, desired) (_InterlockedCompareExchange64((volatile long long*)(p), (long long)(desired), (long long)(expected)) == (long long)(expected))
+#define LOAD64(p) ((uint64_t)_InterlockedOr64((volatile long long*)(p), 0))
+#define STORE64(p, v) _InterlockedExchange64((volatile long long*)(p), (long long)(v))
+#define ADD64(p, v) _InterlockedExchangeAdd64((volatile long long*)(p), (long long)(v))
+#else
+#include <pthread.h>
+#include <unistd.h>
+typedef pthread_t THREAD;
+#define THREAD_FUNC void*
+#define THREAD_RETURN NULL
+#define CAS64(p, expected, desired) __atomic_compare_exchange_n(p, &(uint64_t){ expected }, desired, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)
+#define LOAD64(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define STORE64(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define ADD64(p, v) __atomic_fetch_add(p, v, __ATOMIC_RELAXED)
+#endif
+
+#define MAX_THREADS 64
+#define CASES16_PER_TASK 1000000
+
+/* Task ranges; a task index is split into the test kind and its part */
+#define TASKS_DIV8 256                  // one per dividend high byte
+#define TASKS_MUL8 256                  // one per multiplicand
+#define TASK_DIV8  0
+#define TASK_MUL8  (TASK_DIV8 + TASKS_DIV8)
+#define TASK_16    (TASK_MUL8 + TASKS_MUL8)
+
+/* Per worker cpu. i8086_int() is given the cpu; the divide error is recorded next to it */
+typedef struct VCPU {
+	I8086 cpu;
+	int int_raised;   // i8086_int() was called
+	uint8_t int_type; // the interrupt type
+} VCPU;
+
+/* Work stealing queue; begin in the low 32 bits, end in the high 32 bits */
+typedef struct QUEUE {
+	uint64_t range;
+	uint8_t pad[64 - sizeof(uint64_t)];
+} QUEUE;
+
+typedef struct WORKER {
+	int id;
+	VCPU vcpu;
+	uint64_t cases;    // cases checked
+	uint64_t steals;   // ranges stolen from other workers
+	uint64_t failures; // cases that differed
+} WORKER;
+
+static QUEUE queues[MAX_THREADS];
+static WORKER workers[MAX_THREADS];
+static int worker_count;
+static uint32_t tasks16;
+static uint64_t failures_printed;
+
+#define RANGE(begin, end) (((uint64_t)(end) << 32) | (uint32_t)(begin))
+#define RANGE_BEGIN(r) ((uint32_t)(r))
+#define RANGE_END(r) ((uint32_t)((r) >> 32))
+
+/* The muldiv routines raise the divide error through i8086_int() */
+void i8086_int(I8086* cpu, uint8_t type) {
+	VCPU* vcpu = (VCPU*)cpu;
+	vcpu->int_raised = 1;
+	vcpu->int_type = type;
+}
+
+/* Take the next task of a worker's own range. -1 if the range is empty */
+static int64_t take(QUEUE* q) {
+	for (;;) {
+		uint64_t r = LOAD64(&q->range);
+		uint32_t begin = RANGE_BEGIN(r);
+		uint32_t end = RANGE_END(r);
+		if (begin >= end) {
+			return -1;
+		}
+		if (CAS64(&q->range, r, RANGE(begin + 1, end))) {
+			return begin;
+		}
+	}
+}
+
+/* Steal the back half of another worker's range into q. 0 if every range is empty */
+static int steal(WORKER* w, QUEUE* q) {
+	for (int i = 1; i < worker_count; ++i) {
+		QUEUE* victim = &queues[(w->id + i) % worker_count];
+		for (;;) {
+			uint64_t r = LOAD64(&victim->range);
+			uint32_t begin = RANGE_BEGIN(r);
+			uint32_t end = RANGE_END(r);
+			if (begin >= end) {
+				break;
+			}
+			uint32_t mid = begin + (end - begin) / 2;
+			if (CAS64(&victim->range, r, RANGE(begin, mid))) {
+				STORE64(&q->range, RANGE(mid, end)); // own range is empty; no one else changes it
+				w->steals++;
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+static uint64_t rng_next(uint64_t* s) {
+	*s ^= *s << 13;
+	*s ^= *s >> 7;
+	*s ^= *s << 17;
+	return *s;
+}
+
+static void report(WORKER* w, const char* what, uint32_t a, uint32_t b, int is_signed, int f1) {
+	w->failures++;
+	if (ADD64(&failures_printed, 1) < 10) {
+		printf("MISMATCH %s a=%X b=%X signed=%d f1=%d\n", what, a, b, is_signed, f1);
+	}
+}
+
+/* Set up the cpu for one run; same psw and F1 for both routines */
+static void prepare(VCPU* v, uint16_t psw, int f1) {
+	v->cpu.status.word = psw;
+	v->cpu.internal_flags = f1 ? INTERNAL_FLAG_F1 : 0;
+	v->cpu.cycles = 0;
+	v->int_raised = 0;
+}
+
+static void check_div8(WORKER* w, uint16_t dividend, uint8_t divisor, int is_signed, int f1, uint16_t psw) {
+	VCPU* v = &w->vcpu;
+	uint8_t q[2] = { 0xA5, 0xA5 };
+	uint8_t r[2] = { 0x5A, 0x5A };
+	uint16_t flags[2];
+	uint64_t cycles[2];
+	int err[2];
+
+	prepare(v, psw, f1);
+	mc_div8(&v->cpu, dividend, divisor, is_signed, &q[0], &r[0]);
+	flags[0] = v->cpu.status.word; cycles[0] = v->cpu.cycles; err[0] = v->int_raised;
+
+	prepare(v, psw, f1);
+	fast_div8(&v->cpu, dividend, divisor, is_signed, &q[1], &r[1]);
+	flags[1] = v->cpu.status.word; cycles[1] = v->cpu.cycles; err[1] = v->int_raised;
+
+	w->cases++;
+	if (err[0] != err[1] || flags[0] != flags[1] || cycles[0] != cycles[1] ||
+		(err[0] && (q[1] != 0xA5 || r[1] != 0x5A)) || (!err[0] && (q[0] != q[1] || r[0] != r[1]))) {
+		report(w, is_signed ? "idiv8" : "div8", dividend, divisor, is_signed, f1);
+	}
+}
+
+static void check_mul8(WORKER* w, uint8_t a, uint8_t b, int is_signed, int f1, uint16_t psw) {
+	VCPU* v = &w->vcpu;
+	uint8_t lo[2] = { 0 };
+	uint8_t hi[2] = { 0 };
+	uint16_t flags[2];
+	uint64_t cycles[2];
+	int err[2];
+
+	prepare(v, psw, f1);
+	mc_mul8(&v->cpu, a, b, is_signed, &lo[0], &hi[0]);
+	flags[0] = v->cpu.status.word; cycles[0] = v->cpu.cycles; err[0] = v->int_raised;
+
+	prepare(v, psw, f1);
+	fast_mul8(&v->cpu, a, b, is_signed, &lo[1], &hi[1]);
+	flags[1] = v->cpu.status.word; cycles[1] = v->cpu.cycles; err[1] = v->int_raised;
+
+	w->cases++;
+	if (err[0] != err[1] || flags[0] != flags[1] || cycles[0] != cycles[1] || lo[0] != lo[1] || hi[0] != hi[1]) {
+		report(w, is_signed ? "imul8" : "mul8", a, b, is_signed, f1);
+	}
+}
+
+static void check_div16(WORKER* w, uint32_t dividend, uint16_t divisor, int is_signed, int f1, uint16_t psw) {
+	VCPU* v = &w->vcpu;
+	uint16_t q[2] = { 0xA5A5, 0xA5A5 };
+	uint16_t r[2] = { 0x5A5A, 0x5A5A };
+	uint16_t flags[2];
+	uint64_t cycles[2];
+	int err[2];
+
+	prepare(v, psw, f1);
+	mc_div16(&v->cpu, dividend, divisor, is_signed, &q[0], &r[0]);
+	flags[0] = v->cpu.status.word; cycles[0] = v->cpu.cycles; err[0] = v->int_raised;
+
+	prepare(v, psw, f1);
+	fast_div16(&v->cpu, dividend, divisor, is_signed, &q[1], &r[1]);
+	flags[1] = v->cpu.status.word; cycles[1] = v->cpu.cycles; err[1] = v->int_raised;
+
+	w->cases++;
+	if (err[0] != err[1] || flags[0] != flags[1] || cycles[0] != cycles[1] ||
+		(err[0] && (q[1] != 0xA5A5 || r[1] != 0x5A5A)) || (!err[0] && (q[0] != q[1] || r[0] != r[1]))) {
+		report(w, is_signed ? "idiv16" : "div16", dividend, divisor, is_signed, f1);
+	}
+}
+
+static void check_mul16(WORKER* w, uint16_t a, uint16_t b, int is_signed, int f1, uint16_t psw) {
+	VCPU* v = &w->vcpu;
+	uint16_t lo[2] = { 0 };
+	uint16_t hi[2] = { 0 };
+	uint16_t flags[2];
+	uint64_t cycles[2];
+	int err[2];
+
+	prepare(v, psw, f1);
+	mc_mul16(&v->cpu, a, b, is_signed, &lo[0], &hi[0]);
+	flags[0] = v->cpu.status.word; cycles[0] = v->cpu.cycles; err[0] = v->int_raised;
+
+	prepare(v, psw, f1);
+	fast_mul16(&v->cpu, a, b, is_signed, &lo[1], &hi[1]);
+	flags[1] = v->cpu.status.word; cycles[1] = v->cpu.cycles; err[1] = v->int_raised;
+
+	w->cases++;
+	if (err[0] != err[1] || flags[0] != flags[1] || cycles[0] != cycles[1] || lo[0] != lo[1] || hi[0] != hi[1]) {
+		report(w, is_signed ? "imul16" : "mul16", a, b, is_signed, f1);
+	}
+}
+
+/* One stratified 16-bit case; the set is picked from the low bits of the random word */
+static void case16(WORKER* w, uint64_t* s) {
+	uint64_t r = rng_next(s);
+	uint64_t x = rng_next(s);
+	int is_signed = r & 1;
+	int f1 = (r >> 1) & 1;
+	uint16_t psw = (uint16_t)(r >> 16);
+	uint32_t dividend = (uint32_t)x;
+	uint16_t divisor = (uint16_t)(x >> 32);
+
+	switch ((r >> 2) & 7) {
+		case 0: // divisors below 0x100
+			divisor &= 0xFF;
+			break;
+		case 1: // high word just below the divisor; the overflow boundary
+			dividend = ((uint32_t)(uint16_t)(divisor - ((x >> 48) & 3)) << 16) | (dividend & 0xFFFF);
+			break;
+		case 2: // divisor bit 15 set; the CORD flag walk back
+			divisor |= 0x8000;
+			break;
+		case 3: // divide by 0
+			divisor = 0;
+			break;
+		case 4: { // IDIV quotients of +-0x7FFE to +-0x8001
+			int32_t q = 0x7FFE + (int32_t)((x >> 48) & 3);
+			int16_t d = (int16_t)(divisor | 1);
+			if (d == -32768) {
+				d = 3;
+			}
+			if ((x >> 50) & 1) {
+				q = -q;
+			}
+			dividend = (uint32_t)(q * (int32_t)d + (int32_t)((x >> 51) & 1) * (d < 0 ? -1 : 1));
+			divisor = (uint16_t)d;
+			is_signed = 1;
+			break;
+		}
+		case 5: { // 0x8000 / 0x80000000 operands
+			static const uint32_t dividends[4] = { 0x80000000, 0x7FFFFFFF, 0xFFFF8000, 0x00008000 };
+			static const uint16_t divisors[4] = { 0x8000, 0x7FFF, 0xFFFF, 0x0001 };
+			dividend = dividends[(x >> 48) & 3];
+			divisor = divisors[(x >> 50) & 3];
+			break;
+		}
+	}
+
+	check_div16(w, dividend, divisor, is_signed, f1, psw);
+	check_mul16(w, (uint16_t)dividend, divisor, is_signed, f1, psw);
+}
+
+static void run_task(WORKER* w, uint32_t task) {
+	uint64_t s = 0x9E3779B97F4A7C15ULL ^ ((uint64_t)task * 0xD1B54A32D192ED03ULL);
+	if (s == 0) {
+		s = 1;
+	}
+
+	if (task < TASK_MUL8) {
+		uint16_t hi = (uint16_t)(task - TASK_DIV8);
+		for (uint32_t lo = 0; lo < 0x100; ++lo) {
+			uint16_t dividend = (uint16_t)((hi << 8) | lo);
+			for (uint32_t d = 0; d < 0x100; ++d) {
+				for (int k = 0; k < 4; ++k) {
+					check_div8(w, dividend, (uint8_t)d, k & 1, k >> 1, (uint16_t)rng_next(&s));
+				}
+			}
+		}
+	}
+	else if (task < TASK_16) {
+		uint8_t a = (uint8_t)(task - TASK_MUL8);
+		for (uint32_t b = 0; b < 0x100; ++b) {
+			for (int k = 0; k < 4; ++k) {
+				check_mul8(w, a, (uint8_t)b, k & 1, k >> 1, (uint16_t)rng_next(&s));
+			}
+		}
+	}
+	else {
+		for (uint32_t i = 0; i < CASES16_PER_TASK; ++i) {
+			case16(w, &s);
+		}
+	}
+}
+
+static THREAD_FUNC worker_main(void* arg) {
+	WORKER* w = (WORKER*)arg;
+	QUEUE* q = &queues[w->id];
+	for (;;) {
+		int64_t task = take(q);
+		if (task < 0) {
+			if (!steal(w, q)) {
+				break;
+			}
+			continue;
+		}
+		run_task(w, (uint32_t)task);
+	}
+	return THREAD_RETURN;
+}
+
+static int core_count(void) {
+#ifdef _WIN32
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	return (int)si.dwNumberOfProcessors;
+#else
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? (int)n : 1;
+#endif
+}
+
+static double now(void) {
+#ifdef _WIN32
+	LARGE_INTEGER f, t;
+	QueryPerformanceFrequency(&f);
+	QueryPerformanceCounter(&t);
+	return (double)t.QuadPart / (double)f.QuadPart;
+#else
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+#endif
+}
+
+int main(int argc, char** argv) {
+	uint32_t millions16 = argc > 1 ? (uint32_t)atoi(argv[1]) : 100;
+	worker_count = argc > 2 ? atoi(argv[2]) : core_count();
+	if (worker_count < 1) {
+		worker_count = 1;
+	}
+	if (worker_count > MAX_THREADS) {
+		worker_count = MAX_THREADS;
+	}
+	tasks16 = millions16 * (1000000 / CASES16_PER_TASK);
+
+	/* deal the task indices out in equal ranges; stealing evens out the rest */
+	uint32_t total = TASK_16 + tasks16;
+	for (int i = 0; i < worker_count; ++i) {
+		uint32_t begin = (uint32_t)((uint64_t)total * i / worker_count);
+		uint32_t end = (uint32_t)((uint64_t)total * (i + 1) / worker_count);
+		queues[i].range = RANGE(begin, end);
+		memset(&workers[i], 0, sizeof(workers[i]));
+		workers[i].id = i;
+	}
+
+	double t = now();
+	THREAD threads[MAX_THREADS];
+	for (int i = 1; i < worker_count; ++i) {
+#ifdef _WIN32
+		threads[i] = CreateThread(NULL, 0, worker_main, &workers[i], 0, NULL);
+#else
+		pthread_create(&threads[i], NULL, worker_main, &workers[i]);
+#endif
+	}
+	worker_main(&workers[0]);
+	for (int i = 1; i < worker_count; ++i) {
+#ifdef _WIN32
+		WaitForSingleObject(threads[i], INFINITE);
+		CloseHandle(threads[i]);
+#else
+		pthread_join(threads[i], NULL);
+#endif
+	}
+	t = now() - t;
+
+	uint64_t cases = 0;
+	uint64_t steals = 0;
+	uint64_t failures = 0;
+	for (int i = 0; i < worker_count; ++i) {
+		cases += workers[i].cases;
+		steals += workers[i].steals;
+		failures += workers[i].failures;
+	}
+
+	printf("%d workers, %u tasks, %llu steals\n", worker_count, total, (unsigned long long)steals);
+	printf("8-bit: %u div cases, %u mul cases (exhaustive); 16-bit: %llu div and %llu mul cases\n",
+		0x10000 * 0x100 * 4, 0x100 * 0x100 * 4,
+		(unsigned long long)tasks16 * CASES16_PER_TASK, (unsigned long long)tasks16 * CASES16_PER_TASK);
+	printf("%llu cases in %.1fs; %.1f M cases/s\n", (unsigned long long)cases, t, cases / t / 1e6);
+	if (failures != 0) {
+		printf("FAILED: %llu cases differ\n", (unsigned long long)failures);
+		return 1;
+	}
+	printf("all cases match\n");
+	return 0;
+}
@@ -0,0 +1,192 @@
+/* scheduler_test.c
+ * Thomas J. Armytage 2025 ( https://github.com/tommojphillips/ )
+ * Intel 8086 Event Scheduler Test
+ */
+
+/* Checks the cycle based event scheduler (I8086_ENABLE_SCHEDULER) with i8086_run().
+	- wake: a halted cpu skips to the next deadline; the event raises INTR and the
+	  handler runs
+	- periodic: an event that reschedules itself from its callback runs once per period
+	- cancel: a cancelled event is not called
+	- shorten: an event scheduled from an io callback, earlier than the end of the
+	  run, is called on time and not at the end of the budget
+
+   Every event records cpu->cycles when it is called; it must be at or after the
+   deadline and within one instruction of it.
+
+   Build from the repository root:
+	gcc -O2 -Isrc -DI8086_ENABLE_SCHEDULER tests/scheduler_test.c src/i8086.c src/i8086_sched.c
+		src/i8086_alu.c src/i8086_modrm.c src/i8086_muldiv.c src/sign_extend.c -o scheduler_test
+	./scheduler_test */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "i8086.h"
+
+#ifndef I8086_ENABLE_SCHEDULER
+#error "build with I8086_ENABLE_SCHEDULER"
+#endif
+
+#define LATE 32 // the longest instruction in the test programs, in cycles
+
+static uint8_t mem[0x100000];
+static I8086 cpu;
+
+/* the event under test */
+typedef struct EVENT {
+	uint64_t deadline; // deadline it was last scheduled for
+	uint64_t called;   // cpu->cycles when it was last called
+	int count;         // times called
+	int late;          // times called before the deadline or more than LATE cycles after it
+	uint64_t period;   // reschedule every period cycles from the callback; 0 for one shot
+	int intr;          // raise INTR 20h from the callback
+} EVENT;
+
+static EVENT event;
+static int event_id;
+
+static uint8_t read_mem_byte(I8086* c, void* user, uint20_t address) {
+	(void)c;
+	(void)user;
+	return mem[address & 0xFFFFF];
+}
+static void write_mem_byte(I8086* c, void* user, uint20_t address, uint8_t value) {
+	(void)c;
+	(void)user;
+	mem[address & 0xFFFFF] = value;
+}
+static uint8_t read_io_byte(I8086* c, void* user, uint16_t port) {
+	(void)c;
+	(void)user;
+	(void)port;
+	return 0xFF;
+}
+/* out 80h: schedule the event 50 cycles from now */
+static void write_io_byte(I8086* c, void* user, uint16_t port, uint8_t value) {
+	(void)user;
+	(void)value;
+	if (port == 0x80) {
+		event.deadline = c->cycles + 50;
+		i8086_schedule_event(c, event_id, event.deadline);
+	}
+}
+
+static void event_cb(I8086* c, void* user, int id) {
+	EVENT* e = (EVENT*)user;
+	e->called = c->cycles;
+	e->count++;
+	if (c->cycles < e->deadline || c->cycles > e->deadline + LATE) {
+		e->late++;
+	}
+	if (e->intr) {
+		i8086_intr(c, 0x20);
+	}
+	if (e->period != 0) {
+		e->deadline += e->period;
+		i8086_schedule_event(c, id, e->deadline);
+	}
+}
+
+/* code at 1000:0000; int 20h handler at 3000:0000 counts its calls in byte 0000:0500 */
+static void setup(const uint8_t* code, uint32_t size) {
+	static const uint8_t handler[] = {
+		0xFE, 0x06, 0x00, 0x05, // inc byte [0500h]
+		0xCF,                   // iret
+	};
+	memset(mem, 0, sizeof(mem));
+	memcpy(mem + 0x10000, code, size);
+	memcpy(mem + 0x30000, handler, sizeof(handler));
+	mem[0x20 * 4 + 3] = 0x30;
+
+	i8086_init(&cpu);
+	cpu.funcs.read_mem_byte = read_mem_byte;
+	cpu.funcs.write_mem_byte = write_mem_byte;
+	cpu.funcs.read_io_byte = read_io_byte;
+	cpu.funcs.write_io_byte = write_io_byte;
+	i8086_reset(&cpu);
+	i8086_set_segment(&cpu, SEG_CS, 0x1000);
+	i8086_set_segment(&cpu, SEG_DS, 0x0000);
+	i8086_set_segment(&cpu, SEG_SS, 0x4000);
+	cpu.registers[REG_SP].r16 = 0x0100;
+	cpu.ip = 0;
+
+	memset(&event, 0, sizeof(event));
+	event_id = i8086_add_event(&cpu, event_cb, &event);
+}
+
+static const uint8_t program_loop[] = {
+	0x40,       // l: inc ax
+	0xEB, 0xFD, // jmp l
+};
+
+static int test_wake(void) {
+	static const uint8_t code[] = {
+		0xFB,       // sti
+		0xF4,       // hlt
+		0xEB, 0xFD, // jmp 1 (hlt)
+	};
+	setup(code, sizeof(code));
+	event.intr = 1;
+	event.deadline = 5000;
+	i8086_schedule_event(&cpu, event_id, event.deadline);
+	I8086_RUN_RESULT r = i8086_run(&cpu, 20000);
+	if (event.count != 1 || event.late != 0 || mem[0x500] != 1 || r.reason != I8086_STOP_HALT) {
+		printf("wake: called %d times at %llu for %llu, handler ran %d times, stop %d\n",
+			event.count, (unsigned long long)event.called, (unsigned long long)event.deadline, mem[0x500], r.reason);
+		return 0;
+	}
+	return 1;
+}
+
+static int test_periodic(void) {
+	setup(program_loop, sizeof(program_loop));
+	event.period = 1000;
+	event.deadline = 1000;
+	i8086_schedule_event(&cpu, event_id, event.deadline);
+	i8086_run(&cpu, 10500);
+	if (event.count != 10 || event.late != 0) {
+		printf("periodic: called %d times, %d late\n", event.count, event.late);
+		return 0;
+	}
+	return 1;
+}
+
+static int test_cancel(void) {
+	setup(program_loop, sizeof(program_loop));
+	event.deadline = 500;
+	i8086_schedule_event(&cpu, event_id, event.deadline);
+	i8086_run(&cpu, 100);
+	i8086_cancel_event(&cpu, event_id);
+	i8086_run(&cpu, 2000);
+	if (event.count != 0) {
+		printf("cancel: a cancelled event was called %d times\n", event.count);
+		return 0;
+	}
+	return 1;
+}
+
+static int test_shorten(void) {
+	static const uint8_t code[] = {
+		0xE6, 0x80, // out 80h, al
+		0x40,       // l: inc ax
+		0xEB, 0xFD, // jmp l
+	};
+	setup(code, sizeof(code));
+	i8086_run(&cpu, 100000);
+	if (event.count != 1 || event.late != 0) {
+		printf("shorten: called %d times at %llu for %llu\n",
+			event.count, (unsigned long long)event.called, (unsigned long long)event.deadline);
+		return 0;
+	}
+	return 1;
+}
+
+int main(void) {
+	if (!test_wake() || !test_periodic() || !test_cancel() || !test_shorten()) {
+		return 1;
+	}
+	printf("wake, periodic, cancel and shorten pass\n");
+	return 0;
+}
@@ -0,0 +1,283 @@
+/* shift_rotate_test.c
+ * Thomas J. Armytage 2025 ( https://github.com/tommojphillips/ )
+ * Intel 8086 Shift/Rotate Test
+ */
+
+/* Checks the closed form shift and rotate routines (alu_rol8 .. alu_sar16)
+   against the iterative reference below, which shifts one bit per step the way
+   the ALU used to. Both run from the same psw; the result and the whole psw
+   word must match.
+	- 8-bit: every operand, every count 0-255, every psw image
+	- 16-bit: every operand with counts 0-31, and every 251st operand with counts 32-255
+
+   Build from the repository root:
+	gcc -O2 -Isrc tests/shift_rotate_test.c src/i8086_alu.c src/i8086_muldiv.c -o shift_rotate_test
+	./shift_rotate_test */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "i8086.h"
+#include "i8086_alu.h"
+#include "i8086_alu_ops.h"
+
+/* The ALU raises the divide error through i8086_int(); not reached here */
+void i8086_int(I8086* cpu, uint8_t type) {
+	(void)cpu;
+	(void)type;
+}
+
+/* Reference: one bit per step */
+
+static void ref_rcl8(I8086* cpu, uint8_t* x1, uint8_t count) {
+	SYNC_FLAGS();
+	for (int i = 0; i < count; ++i) {
+		uint8_t cf = CF;
+		CF = (*x1 >> 7) & 1;
+		*x1 = (*x1 << 1) | cf;
+	}
+	if (count != 0) {
+		OF = ((*x1 >> 7) & 1) ^ CF;
+	}
+}
+static void ref_rcr8(I8086* cpu, uint8_t* x1, uint8_t count) {
+	SYNC_FLAGS();
+	for (int i = 0; i < count; ++i) {
+		uint8_t cf = CF;
+		CF = (*x1 & 1);
+		*x1 = (*x1 >> 1) | (cf << 7);
+	}
+	if (count != 0) {
+		OF = (*x1 >> 7) ^ ((*x1 >> 6) & 1);
+	}
+}
+static void ref_rol8(I8086* cpu, uint8_t* x1, uint8_t count) {
+	SYNC_FLAGS();
+	for (int i = 0; i < count; ++i) {
+		CF = (*x1 >> 7) & 1;
+		*x1 = (*x1 << 1) | CF;
+	}
+	if (count != 0) {
+		OF = ((*x1 >> 7) & 1) ^ CF;
+	}
+}
+static void ref_ror8(I8086* cpu, uint8_t* x1, uint8_t count) {
+	SYNC_FLAGS();
+	for (int i = 0; i < count; ++i) {
+		CF = (*x1 & 1);
+		*x1 = (*x1 >> 1) | (CF << 7);
+	}
+	if (count != 0) {
+		OF = (*x1 >> 7) ^ ((*x1 >> 6) & 1);
+	}
+}
+static void ref_shl8(I8086* cpu, uint8_t* x1, uint8_t count) {
+	SYNC_FLAGS();
+	for (int i = 0; i < count; ++i) {
+		CF = (*x1 >> 7) & 1;
+		*x1 <<= 1;
+	}
+	if (count != 0) {
+		OF = ((*x1 >> 7) & 1) ^ CF;
+		AF = (*x1 & 0x10) != 0;
+		SET_SZP8(*x1);
+	}
+}
+static void ref_shr8(I8086* cpu, uint8_t* x1, uint8_t count) {
+	SYNC_FLAGS();
+	for (int i = 0; i < count; ++i) {
+		OF = (*x1 >> 7) & 1;
+		CF = (*x1 & 1);
+		*x1 >>= 1;
+	}
+	if (count != 0) {
+		AF = 0;
+		SET_SZP8(*x1);
+	}
+}
+static void ref_sar8(I8086* cpu, uint8_t* x1, uint8_t count) {
+	SYNC_FLAGS();
+	for (int i = 0; i < count; ++i) {
+		CF = (*x1 & 1);
+		uint8_t msb = (*x1 & 0x80);
+		*x1 >>= 1;
+		*x1 |= msb;
+	}
+	if (count != 0) {
+		OF = 0;
+		AF = 0;
+		SET_SZP8(*x1);
+	}
+}
+
+static void ref_rcl16(I8086* cpu, uint16_t* x1, uint8_t count) {
+	SYNC_FLAGS();
+	for (int i = 0; i < count; ++i) {
+		uint8_t cf = CF;
+		CF = (*x1 >> 15) & 1;
+		*x1 = (*x1 << 1) | cf;
+	}
+	if (count != 0) {
+		OF = ((*x1 >> 15) & 1) ^ CF;
+	}
+}
+static void ref_rcr16(I8086* cpu, uint16_t* x1, uint8_t count) {
+	SYNC_FLAGS();
+	for (int i = 0; i < count; ++i) {
+		uint8_t cf = CF;
+		CF = (*x1 & 1);
+		*x1 = (*x1 >> 1) | (cf << 15);
+	}
+	if (count != 0) {
+		OF = (*x1 >> 15) ^ ((*x1 >> 14) & 1);
+	}
+}
+static void ref_rol16(I8086* cpu, uint16_t* x1, uint8_t count) {
+	SYNC_FLAGS();
+	for (int i = 0; i < count; ++i) {
+		CF = (*x1 >> 15) & 1;
+		*x1 = (*x1 << 1) | CF;
+	}
+	if (count != 0) {
+		OF = ((*x1 >> 15) & 1) ^ CF;
+	}
+}
+static void ref_ror16(I8086* cpu, uint16_t* x1, uint8_t count) {
+	SYNC_FLAGS();
+	for (int i = 0; i < count; ++i) {
+		CF = (*x1 & 1);
+		*x1 = (*x1 >> 1) | (CF << 15);
+	}
+	if (count != 0) {
+		OF = (*x1 >> 15) ^ ((*x1 >> 14) & 1);
+	}
+}
+static void ref_shl16(I8086* cpu, uint16_t* x1, uint8_t count) {
+	SYNC_FLAGS();
+	for (int i = 0; i < count; ++i) {
+		CF = (*x1 >> 15) & 1;
+		*x1 <<= 1;
+	}
+	if (count != 0) {
+		OF = ((*x1 >> 15) & 1) ^ CF;
+		AF = (*x1 & 0x10) != 0;
+		SET_SZP16(*x1);
+	}
+}
+static void ref_shr16(I8086* cpu, uint16_t* x1, uint8_t count) {
+	SYNC_FLAGS();
+	for (int i = 0; i < count; ++i) {
+		OF = (*x1 >> 15) & 1;
+		CF = (*x1 & 1);
+		*x1 >>= 1;
+	}
+	if (count != 0) {
+		AF = 0;
+		SET_SZP16(*x1);
+	}
+}
+static void ref_sar16(I8086* cpu, uint16_t* x1, uint8_t count) {
+	SYNC_FLAGS();
+	for (int i = 0; i < count; ++i) {
+		CF = (*x1 & 1);
+		uint16_t msb = (*x1 & 0x8000);
+		*x1 >>= 1;
+		*x1 |= msb;
+	}
+	if (count != 0) {
+		OF = 0;
+		AF = 0;
+		SET_SZP16(*x1);
+	}
+}
+
+typedef void(*SHIFT8)(I8086* cpu, uint8_t* x1, uint8_t count);
+typedef void(*SHIFT16)(I8086* cpu, uint16_t* x1, uint8_t count);
+
+typedef struct {
+	const char* name;
+	SHIFT8 ref8;
+	SHIFT8 alu8;
+	SHIFT16 ref16;
+	SHIFT16 alu16;
+} OP;
+
+static const OP ops[] = {
+	{ "rcl", ref_rcl8, alu_rcl8, ref_rcl16, alu_rcl16 },
+	{ "rcr", ref_rcr8, alu_rcr8, ref_rcr16, alu_rcr16 },
+	{ "rol", ref_rol8, alu_rol8, ref_rol16, alu_rol16 },
+	{ "ror", ref_ror8, alu_ror8, ref_ror16, alu_ror16 },
+	{ "shl", ref_shl8, alu_shl8, ref_shl16, alu_shl16 },
+	{ "shr", ref_shr8, alu_shr8, ref_shr16, alu_shr16 },
+	{ "sar", ref_sar8, alu_sar8, ref_sar16, alu_sar16 },
+};
+
+/* psw images; CF clear/set, the other status flags clear/set */
+static const uint16_t psws[] = { 0xF002, 0xF003, 0xFFD6, 0xFFD7, 0xF8C3, 0xF014 };
+
+#define OP_COUNT (sizeof(ops) / sizeof(ops[0]))
+#define PSW_COUNT (sizeof(psws) / sizeof(psws[0]))
+
+static I8086 ref_cpu;
+static I8086 alu_cpu;
+static uint64_t cases;
+
+static int check8(const OP* op, uint16_t psw, uint8_t x, uint8_t count) {
+	uint8_t ref_x = x;
+	uint8_t alu_x = x;
+	ref_cpu.status.word = psw;
+	alu_cpu.status.word = psw;
+	op->ref8(&ref_cpu, &ref_x, count);
+	op->alu8(&alu_cpu, &alu_x, count);
+	cases++;
+	if (ref_x != alu_x || ref_cpu.status.word != alu_cpu.status.word) {
+		printf("%s8 %02X,%u psw %04X: expected %02X psw %04X, got %02X psw %04X\n",
+			op->name, x, count, psw, ref_x, ref_cpu.status.word, alu_x, alu_cpu.status.word);
+		return 0;
+	}
+	return 1;
+}
+
+static int check16(const OP* op, uint16_t psw, uint16_t x, uint8_t count) {
+	uint16_t ref_x = x;
+	uint16_t alu_x = x;
+	ref_cpu.status.word = psw;
+	alu_cpu.status.word = psw;
+	op->ref16(&ref_cpu, &ref_x, count);
+	op->alu16(&alu_cpu, &alu_x, count);
+	cases++;
+	if (ref_x != alu_x || ref_cpu.status.word != alu_cpu.status.word) {
+		printf("%s16 %04X,%u psw %04X: expected %04X psw %04X, got %04X psw %04X\n",
+			op->name, x, count, psw, ref_x, ref_cpu.status.word, alu_x, alu_cpu.status.word);
+		return 0;
+	}
+	return 1;
+}
+
+int main(void) {
+	memset(&ref_cpu, 0, sizeof(ref_cpu));
+	memset(&alu_cpu, 0, sizeof(alu_cpu));
+
+	for (size_t o = 0; o < OP_COUNT; ++o) {
+		for (size_t p = 0; p < PSW_COUNT; ++p) {
+			for (uint32_t x = 0; x < 0x100; ++x) {
+				for (uint32_t count = 0; count < 0x100; ++count) {
+					if (!check8(&ops[o], psws[p], (uint8_t)x, (uint8_t)count)) {
+						return 1;
+					}
+				}
+			}
+			for (uint32_t x = 0; x < 0x10000; ++x) {
+				uint32_t counts = (x % 251) == 0 ? 0x100 : 32;
+				for (uint32_t count = 0; count < counts; ++count) {
+					if (!check16(&ops[o], psws[p], (uint16_t)x, (uint8_t)count)) {
+						return 1;
+					}
+				}
+			}
+		}
+	}
+	printf("%llu cases match\n", (unsigned long long)cases);
+	return 0;
+}